@@ -0,0 +1,155 @@
+/*  $Id$
+    BenchmarkRunner.cpp - Timing and reporting of microbenchmarks.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include "BenchmarkRunner.h"
+
+#include <flatzebra/MonotonicClock.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace flatzebra;
+
+
+volatile int BenchmarkRunner::intSink = 0;
+volatile double BenchmarkRunner::doubleSink = 0;
+
+
+Benchmark::~Benchmark()
+{
+}
+
+
+BenchmarkRunner::BenchmarkRunner(FILE *_output, Format _format,
+                                 double minSeconds)
+  : output(_output),
+    format(_format),
+    minNanoseconds(Uint64(minSeconds * 1e9)),
+    filter(),
+    numResults(0)
+{
+    if (format == CSV)
+        fprintf(output, "name,operations,ns_per_op,items_per_sec\n");
+    else
+        fprintf(output, "[\n");
+    fflush(output);
+}
+
+
+BenchmarkRunner::~BenchmarkRunner()
+{
+    if (format == JSON)
+        fprintf(output, "%s]\n", numResults == 0 ? "" : "\n");
+    fflush(output);
+}
+
+
+void
+BenchmarkRunner::setFilter(const string &substring)
+{
+    filter = substring;
+}
+
+
+void
+BenchmarkRunner::measure(const string &name, Benchmark &benchmark,
+                         double itemsPerOperation)
+{
+    if (name.find(filter) == string::npos)
+        return;
+
+    // Find a number of operations that lasts at least minNanoseconds.
+    unsigned long numOperations = 1;
+    for (;;)
+    {
+        Uint64 elapsed = time(benchmark, numOperations);
+        if (elapsed >= minNanoseconds)
+            break;
+        if (elapsed < minNanoseconds / 100)
+            numOperations *= 10;
+        else
+        {
+            // Aim 20% above the minimum.
+            double factor = 1.2 * double(minNanoseconds) / double(elapsed);
+            numOperations = (unsigned long) (double(numOperations) * factor) + 1;
+        }
+    }
+
+    vector<Uint64> times;
+    for (int i = 0; i < NUM_REPETITIONS; i++)
+        times.push_back(time(benchmark, numOperations));
+    nth_element(times.begin(), times.begin() + NUM_REPETITIONS / 2, times.end());
+    double median = double(times[NUM_REPETITIONS / 2]);
+
+    report(name, numOperations, median / double(numOperations),
+           itemsPerOperation);
+}
+
+
+void
+BenchmarkRunner::report(const string &name, unsigned long numOperations,
+                        double nanosecondsPerOperation,
+                        double itemsPerOperation)
+{
+    double itemsPerSecond = (nanosecondsPerOperation > 0
+                    ? itemsPerOperation * 1e9 / nanosecondsPerOperation
+                    : 0);
+
+    // Names are identifiers: they need no quoting.
+    if (format == CSV)
+        fprintf(output, "%s,%lu,%.3f,%.0f\n",
+                name.c_str(), numOperations,
+                nanosecondsPerOperation, itemsPerSecond);
+    else
+        fprintf(output,
+                "%s  {\"name\": \"%s\", \"operations\": %lu,"
+                " \"ns_per_op\": %.3f, \"items_per_sec\": %.0f}",
+                numResults == 0 ? "" : ",\n",
+                name.c_str(), numOperations,
+                nanosecondsPerOperation, itemsPerSecond);
+    fflush(output);
+    numResults++;
+}
+
+
+Uint64
+BenchmarkRunner::time(Benchmark &benchmark, unsigned long numOperations)
+{
+    Uint64 start = MonotonicClock::getNanoseconds();
+    benchmark.run(numOperations);
+    return MonotonicClock::getNanoseconds() - start;
+}
+
+
+/*static*/
+bool
+BenchmarkRunner::parseFormat(const string &name, Format &format)
+{
+    if (name == "csv")
+        format = CSV;
+    else if (name == "json")
+        format = JSON;
+    else
+        return false;
+    return true;
+}
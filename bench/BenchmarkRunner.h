@@ -0,0 +1,138 @@
+/*  $Id$
+    BenchmarkRunner.h - Timing and reporting of microbenchmarks.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_BenchmarkRunner
+#define _H_BenchmarkRunner
+
+#include <SDL_types.h>
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+
+class Benchmark
+/*  Operation to be timed. Derived classes implement run().
+*/
+{
+public:
+
+    virtual ~Benchmark();
+
+    virtual void run(unsigned long numOperations) = 0;
+    /*  Performs the operation 'numOperations' times.
+        The result of each operation should be passed to
+        BenchmarkRunner::consume() so that the compiler cannot
+        remove the work.
+    */
+};
+
+
+class BenchmarkRunner
+/*  Times benchmarks and writes their results to a file, one line
+    per benchmark, as CSV or as JSON.
+
+    Each benchmark is first run with increasing numbers of operations
+    until a run lasts long enough to be timed reliably. It is then run
+    NUM_REPETITIONS times with that number of operations, and the median
+    time is reported, in nanoseconds per operation, along with the number
+    of items processed per second (e.g., pixels or sprite pairs).
+*/
+{
+public:
+
+    enum Format { CSV, JSON };
+
+    enum { NUM_REPETITIONS = 5 };
+
+    BenchmarkRunner(FILE *output, Format format, double minSeconds);
+    /*  'minSeconds' is the minimum duration of each repetition.
+        The results are written to 'output', which is not closed.
+    */
+
+    ~BenchmarkRunner();
+    /*  Terminates the output (the JSON array).
+    */
+
+    void setFilter(const std::string &substring);
+    /*  Only the benchmarks whose names contain 'substring' are run.
+        An empty string selects all the benchmarks.
+    */
+
+    void measure(const std::string &name, Benchmark &benchmark,
+                 double itemsPerOperation = 1);
+    /*  Times 'benchmark' and writes a result line for it, unless its
+        name is excluded by the filter.
+    */
+
+    void report(const std::string &name, unsigned long numOperations,
+                double nanosecondsPerOperation, double itemsPerOperation);
+    /*  Writes a result line measured by other means.
+    */
+
+    static void consume(int value);
+    static void consume(double value);
+    /*  Makes 'value' observable, so that the computation of this value
+        is not optimized away.
+    */
+
+    static bool parseFormat(const std::string &name, Format &format);
+    /*  Converts "csv" or "json". Returns false for other names.
+    */
+
+private:
+
+    Uint64 time(Benchmark &benchmark, unsigned long numOperations);
+
+    FILE *output;
+    Format format;
+    Uint64 minNanoseconds;
+    std::string filter;
+    size_t numResults;
+
+    static volatile int intSink;
+    static volatile double doubleSink;
+
+    // Forbidden operations:
+    BenchmarkRunner(const BenchmarkRunner &);
+    BenchmarkRunner &operator = (const BenchmarkRunner &);
+};
+
+
+inline
+void
+BenchmarkRunner::consume(int value)
+{
+    intSink = value;
+}
+
+
+inline
+void
+BenchmarkRunner::consume(double value)
+{
+    doubleSink = value;
+}
+
+
+#endif  /* _H_BenchmarkRunner */
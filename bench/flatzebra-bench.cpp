@@ -0,0 +1,735 @@
+/*  $Id$
+    flatzebra-bench.cpp - Microbenchmarks of the library's primitives.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include "BenchmarkRunner.h"
+
+#include <flatzebra/GameEngine.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+static const char *ballXPM[] =
+{
+    "32 32 3 1",
+    "  c None",
+    ". c #E0E0FF",
+    "o c #2040C0",
+    "                                ",
+    "            oooooooo            ",
+    "         oooooooooooooo         ",
+    "        oooooooooooooooo        ",
+    "      oooooooooooooooooooo      ",
+    "     oooooooo......oooooooo     ",
+    "    oooooo............oooooo    ",
+    "    ooooo..............ooooo    ",
+    "   ooooo................ooooo   ",
+    "  ooooo..................ooooo  ",
+    "  oooo....................oooo  ",
+    "  oooo....................oooo  ",
+    " ooooo....................ooooo ",
+    " oooo......................oooo ",
+    " oooo......................oooo ",
+    " oooo......................oooo ",
+    " oooo......................oooo ",
+    " oooo......................oooo ",
+    " oooo......................oooo ",
+    " ooooo....................ooooo ",
+    "  oooo....................oooo  ",
+    "  oooo....................oooo  ",
+    "  ooooo..................ooooo  ",
+    "   ooooo................ooooo   ",
+    "    ooooo..............ooooo    ",
+    "    oooooo............oooooo    ",
+    "     oooooooo......oooooooo     ",
+    "      oooooooooooooooooooo      ",
+    "        oooooooooooooooo        ",
+    "         oooooooooooooo         ",
+    "            oooooooo            ",
+    "                                "
+};
+
+
+static const int SCREEN_WIDTH = 640;
+static const int SCREEN_HEIGHT = 480;
+static const size_t NUM_POINTS = 256;  // power of 2
+
+
+static Uint32 randomState = 12345;
+
+
+static int
+getRandom(int range)
+// Deterministic pseudo-random number in [0, range).
+{
+    randomState = randomState * 1103515245 + 12345;
+    return int((randomState >> 8) % Uint32(range));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+class BenchEngine : public GameEngine
+/*  Headless engine that gives access to the drawing primitives.
+*/
+{
+public:
+
+    BenchEngine() throw(string)
+      : GameEngine(Couple(SCREEN_WIDTH, SCREEN_HEIGHT), "flatzebra-bench",
+                   false, false, true)
+    {
+    }
+
+    virtual void processKey(SDLKey, bool) {}
+    virtual bool tick() { return false; }
+
+    // The drawing primitives are protected in GameEngine.
+    using GameEngine::copySpritePixmap;
+    using GameEngine::submitSprite;
+    using GameEngine::copyBackground;
+    using GameEngine::copyPixmap;
+    using GameEngine::copyTileMap;
+    using GameEngine::flushDrawList;
+    using GameEngine::writeString;
+    using GameEngine::drawLine;
+    using GameEngine::drawPixel;
+    using GameEngine::drawPixels;
+    using GameEngine::fillRect;
+
+    void loadBall(PixmapArray &pa) throw(PixmapLoadError)
+    {
+        loadPixmap(ballXPM, pa, 0);
+    }
+
+    void setPixmapFormat(SDL_Surface *surface)
+    // Converts the pixmaps to the format of 'surface', or of the screen
+    // if 'surface' is null, as setVideoMode() does.
+    {
+        PixmapArray::setDisplaySurface(surface != NULL ? surface : theSDLScreen);
+        PixmapArray::convertAllToDisplayFormat();
+        fixedWidthFontPixmap = fixedWidthFontArray.getImage(0);
+        size_t budget = getStringCacheBudget();
+        setStringCacheBudget(0);  // composited with the previous font
+        setStringCacheBudget(budget);
+    }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+class CoupleArithmetic : public Benchmark
+{
+public:
+    virtual void run(unsigned long n)
+    {
+        Couple pos(1, 2), speed(3, -1);
+        for (unsigned long i = 0; i < n; i++)
+        {
+            pos += speed;
+            pos = (pos - speed * 2) / 2 + speed;
+        }
+        BenchmarkRunner::consume(pos.x + pos.y);
+    }
+};
+
+
+class RCoupleArithmetic : public Benchmark
+{
+public:
+    virtual void run(unsigned long n)
+    {
+        RCouple pos(1.5, 2.5), speed(0.25, -0.75);
+        for (unsigned long i = 0; i < n; i++)
+        {
+            pos += speed * 0.5;
+            pos = (pos - speed) / 1.5 + speed;
+        }
+        BenchmarkRunner::consume(pos.x + pos.y);
+    }
+};
+
+
+class ClosestPointOnSegment : public Benchmark
+{
+public:
+    ClosestPointOnSegment()
+    {
+        for (size_t i = 0; i < NUM_POINTS; i++)
+            points[i] = RCouple(getRandom(SCREEN_WIDTH), getRandom(SCREEN_HEIGHT));
+    }
+
+    virtual void run(unsigned long n)
+    {
+        const RCouple segStart(100, 50), segEnd(500, 400);
+        double sum = 0;
+        for (unsigned long i = 0; i < n; i++)
+        {
+            RCouple p = points[i & (NUM_POINTS - 1)].getClosestPointOnSegment(
+                                                            segStart, segEnd);
+            sum += p.x;
+        }
+        BenchmarkRunner::consume(sum);
+    }
+
+private:
+    RCouple points[NUM_POINTS];
+};
+
+
+class RectangleCollision : public Benchmark
+{
+public:
+    RectangleCollision()
+    {
+        for (size_t i = 0; i < NUM_POINTS; i++)
+            points[i] = RCouple(getRandom(SCREEN_WIDTH), getRandom(SCREEN_HEIGHT));
+    }
+
+    virtual void run(unsigned long n)
+    {
+        const RCouple size(32, 32);
+        int count = 0;
+        for (unsigned long i = 0; i < n; i++)
+        {
+            const RCouple &a = points[i & (NUM_POINTS - 1)];
+            const RCouple &b = points[(i * 7 + 1) & (NUM_POINTS - 1)];
+            count += RCouple::rectangleCollision(a, size, b, size);
+        }
+        BenchmarkRunner::consume(count);
+    }
+
+private:
+    RCouple points[NUM_POINTS];
+};
+
+
+class SpriteCollision : public Benchmark
+{
+public:
+    SpriteCollision(const PixmapArray &pa)
+      : sprites()
+    {
+        for (size_t i = 0; i < NUM_POINTS; i++)
+            sprites.push_back(new Sprite(pa,
+                        Couple(getRandom(SCREEN_WIDTH), getRandom(SCREEN_HEIGHT)),
+                        Couple(), Couple(), Couple(2, 2), Couple(28, 28)));
+    }
+
+    ~SpriteCollision()
+    {
+        for (size_t i = 0; i < sprites.size(); i++)
+            delete sprites[i];
+    }
+
+    virtual void run(unsigned long n)
+    {
+        int count = 0;
+        for (unsigned long i = 0; i < n; i++)
+        {
+            const Sprite &a = *sprites[i & (NUM_POINTS - 1)];
+            const Sprite &b = *sprites[(i * 7 + 1) & (NUM_POINTS - 1)];
+            count += a.collidesWithSprite(b);
+        }
+        BenchmarkRunner::consume(count);
+    }
+
+private:
+    vector<Sprite *> sprites;
+};
+
+
+class CopySpritePixmap : public Benchmark
+/*  Blits a sprite's pixmap on a memory surface of a given depth,
+    possibly at positions shifted out of the surface.
+*/
+{
+public:
+    CopySpritePixmap(BenchEngine &e, const PixmapArray &pa, SDL_Surface *s,
+                     Couple offset = Couple())
+      : engine(e), sprite(pa, Couple(), Couple(), Couple(), Couple(), Couple(32, 32)),
+        surface(s)
+    {
+        for (size_t i = 0; i < NUM_POINTS; i++)
+            positions[i] = offset + Couple(getRandom(SCREEN_WIDTH - 32),
+                                           getRandom(SCREEN_HEIGHT - 32));
+    }
+
+    virtual void run(unsigned long n)
+    {
+        for (unsigned long i = 0; i < n; i++)
+            engine.copySpritePixmap(sprite, 0, positions[i & (NUM_POINTS - 1)],
+                                    surface);
+    }
+
+private:
+    BenchEngine &engine;
+    Sprite sprite;
+    SDL_Surface *surface;
+    Couple positions[NUM_POINTS];
+};
+
+
+class SubmitSprites : public Benchmark
+/*  One operation submits NUM_POINTS sprites on 4 layers to the draw list
+    and flushes it.
+*/
+{
+public:
+    SubmitSprites(BenchEngine &e, const PixmapArray &pa)
+      : engine(e), sprite(pa, Couple(), Couple(), Couple(), Couple(), Couple(32, 32))
+    {
+        for (size_t i = 0; i < NUM_POINTS; i++)
+            positions[i] = Couple(getRandom(SCREEN_WIDTH - 32),
+                                  getRandom(SCREEN_HEIGHT - 32));
+    }
+
+    virtual void run(unsigned long n)
+    {
+        for (unsigned long i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < NUM_POINTS; j++)
+                engine.submitSprite(sprite, 0, positions[j], int(j & 3));
+            engine.flushDrawList();
+        }
+    }
+
+private:
+    BenchEngine &engine;
+    Sprite sprite;
+    Couple positions[NUM_POINTS];
+};
+
+
+class WriteString : public Benchmark
+{
+public:
+    WriteString(BenchEngine &e, const char *t)
+      : engine(e), text(t)
+    {
+    }
+
+    virtual void run(unsigned long n)
+    {
+        for (unsigned long i = 0; i < n; i++)
+            engine.writeString(text, Couple(int(i & 255), int(i & 127)));
+    }
+
+private:
+    BenchEngine &engine;
+    const char *text;
+};
+
+
+class DrawLine : public Benchmark
+/*  Antialiased lines drawn with Wu's algorithm.
+*/
+{
+public:
+    DrawLine(BenchEngine &e)
+      : engine(e)
+    {
+        for (size_t i = 0; i < NUM_POINTS; i++)
+            points[i] = Couple(getRandom(SCREEN_WIDTH), getRandom(SCREEN_HEIGHT));
+    }
+
+    virtual void run(unsigned long n)
+    {
+        for (unsigned long i = 0; i < n; i++)
+        {
+            const Couple &a = points[i & (NUM_POINTS - 1)];
+            const Couple &b = points[(i + 1) & (NUM_POINTS - 1)];
+            engine.drawLine(a.x, a.y, b.x, b.y, 0xFFFFFF);
+        }
+    }
+
+private:
+    BenchEngine &engine;
+    Couple points[NUM_POINTS];
+};
+
+
+class DrawPixel : public Benchmark
+{
+public:
+    DrawPixel(BenchEngine &e)
+      : engine(e)
+    {
+        for (size_t i = 0; i < NUM_POINTS; i++)
+            points[i] = Couple(getRandom(SCREEN_WIDTH), getRandom(SCREEN_HEIGHT));
+    }
+
+    virtual void run(unsigned long n)
+    {
+        for (unsigned long i = 0; i < n; i++)
+        {
+            const Couple &p = points[i & (NUM_POINTS - 1)];
+            engine.drawPixel(p.x, p.y, Uint32(i));
+        }
+    }
+
+private:
+    BenchEngine &engine;
+    Couple points[NUM_POINTS];
+};
+
+
+class DrawPixels : public Benchmark
+/*  One operation sets NUM_POINTS pixels.
+*/
+{
+public:
+    DrawPixels(BenchEngine &e)
+      : engine(e)
+    {
+        for (size_t i = 0; i < NUM_POINTS; i++)
+            points[i] = Couple(getRandom(SCREEN_WIDTH), getRandom(SCREEN_HEIGHT));
+    }
+
+    virtual void run(unsigned long n)
+    {
+        for (unsigned long i = 0; i < n; i++)
+            engine.drawPixels(points, NUM_POINTS, Uint32(i));
+    }
+
+private:
+    BenchEngine &engine;
+    Couple points[NUM_POINTS];
+};
+
+
+class FillRect : public Benchmark
+{
+public:
+    FillRect(BenchEngine &e, int s)
+      : engine(e), size(s)
+    {
+    }
+
+    virtual void run(unsigned long n)
+    {
+        for (unsigned long i = 0; i < n; i++)
+            engine.fillRect(int(i & 255), int(i & 127), size, size, Uint32(i));
+    }
+
+private:
+    BenchEngine &engine;
+    int size;
+};
+
+
+class TiledBackground : public ScrollingBackground
+/*  Background made of copies of an image, one per 32x32 tile.
+*/
+{
+public:
+    TiledBackground(Couple size, const PixmapArray &pa)
+      : ScrollingBackground(size), tiles(pa)
+    {
+    }
+
+protected:
+    virtual void drawRegion(SDL_Surface *dest, Couple destPos,
+                            Couple worldPos, Couple regionSize)
+    {
+        const int t = 32;
+        int x0 = worldPos.x - ((worldPos.x % t) + t) % t;
+        int y0 = worldPos.y - ((worldPos.y % t) + t) % t;
+        SDL_Rect srcrect = tiles.getImageRect(0);
+        for (int y = y0; y < worldPos.y + regionSize.y; y += t)
+            for (int x = x0; x < worldPos.x + regionSize.x; x += t)
+            {
+                SDL_Rect dstrect = { Sint16(destPos.x + x - worldPos.x),
+                                     Sint16(destPos.y + y - worldPos.y), 0, 0 };
+                SDL_BlitSurface(tiles.getImage(0), &srcrect, dest, &dstrect);
+            }
+    }
+
+private:
+    const PixmapArray &tiles;
+};
+
+
+class ScrollBackground : public Benchmark
+{
+public:
+    ScrollBackground(BenchEngine &e, ScrollingBackground &b, int s)
+      : engine(e), background(b), step(s),
+        viewport(Couple(0, 0), Couple(SCREEN_WIDTH, SCREEN_HEIGHT))
+    {
+    }
+
+    virtual void run(unsigned long n)
+    {
+        engine.setViewport(&viewport);
+        for (unsigned long i = 0; i < n; i++)
+        {
+            if (step == 0)
+                background.invalidate();
+            viewport.scrollBy(Couple(step, step / 2));
+            engine.copyBackground(background);
+        }
+        engine.setViewport(NULL);
+    }
+
+private:
+    BenchEngine &engine;
+    ScrollingBackground &background;
+    int step;  // 0 means redrawing everything each time
+    Viewport viewport;
+};
+
+
+class DrawTileMap : public Benchmark
+{
+public:
+    DrawTileMap(BenchEngine &e, TileMap &m, const PixmapArray &pa, bool chunks)
+      : engine(e), map(m), tiles(pa), useChunks(chunks)
+    {
+    }
+
+    virtual void run(unsigned long n)
+    {
+        Couple tileSize = map.getTileSize();
+        for (unsigned long i = 0; i < n; i++)
+        {
+            Couple pos(-int(i % 32), -int(i % 32));  // scrolling
+            if (useChunks)
+            {
+                engine.copyTileMap(map, pos);
+                continue;
+            }
+            // What games do without TileMap: one blit per visible tile.
+            for (int row = 0; row * tileSize.y + pos.y < SCREEN_HEIGHT; row++)
+                for (int col = 0; col * tileSize.x + pos.x < SCREEN_WIDTH; col++)
+                    engine.copyPixmap(tiles, map.getTile(col, row),
+                                      pos + Couple(col * tileSize.x,
+                                                   row * tileSize.y));
+        }
+    }
+
+private:
+    BenchEngine &engine;
+    TileMap &map;
+    const PixmapArray &tiles;
+    bool useChunks;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+static SDL_Surface *
+createSurface(int depth)
+{
+    Uint32 r = 0, g = 0, b = 0;
+    switch (depth)
+    {
+        case 15: r = 0x7C00; g = 0x03E0; b = 0x001F; break;
+        case 16: r = 0xF800; g = 0x07E0; b = 0x001F; break;
+        case 24:
+        case 32: r = 0xFF0000; g = 0x00FF00; b = 0x0000FF; break;
+    }
+    return SDL_CreateRGBSurface(SDL_SWSURFACE, SCREEN_WIDTH, SCREEN_HEIGHT,
+                                depth, r, g, b, 0);
+}
+
+
+static void
+usage(const char *programName)
+{
+    fprintf(stderr,
+            "Usage: %s [--format=csv|json] [--min-time=SECONDS]"
+            " [--filter=SUBSTRING]\n"
+            "Runs microbenchmarks of the flatzebra library and writes\n"
+            "their time per operation and throughput on the standard output.\n",
+            programName);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    BenchmarkRunner::Format format = BenchmarkRunner::CSV;
+    double minSeconds = 0.1;
+    string filter;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--format=", 9) == 0)
+        {
+            if (!BenchmarkRunner::parseFormat(arg + 9, format))
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(arg, "--min-time=", 11) == 0)
+            minSeconds = atof(arg + 11);
+        else if (strncmp(arg, "--filter=", 9) == 0)
+            filter = arg + 9;
+        else
+        {
+            usage(argv[0]);
+            return strcmp(arg, "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    try
+    {
+        BenchEngine engine;
+        PixmapArray ballArray(1);
+        engine.loadBall(ballArray);
+
+        BenchmarkRunner runner(stdout, format, minSeconds);
+        runner.setFilter(filter);
+
+        {
+            CoupleArithmetic b;
+            runner.measure("couple_arithmetic", b);
+        }
+        {
+            RCoupleArithmetic b;
+            runner.measure("rcouple_arithmetic", b);
+        }
+        {
+            ClosestPointOnSegment b;
+            runner.measure("rcouple_closest_point_on_segment", b);
+        }
+        {
+            RectangleCollision b;
+            runner.measure("rcouple_rectangle_collision", b);
+        }
+        {
+            SpriteCollision b(ballArray);
+            runner.measure("sprite_collides_with_sprite", b);
+        }
+
+        static const int depths[] = { 8, 15, 16, 24, 32 };
+        for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+        {
+            SDL_Surface *surface = createSurface(depths[i]);
+            if (surface == NULL)
+            {
+                fprintf(stderr, "%s: %d-bit surface: %s\n",
+                        argv[0], depths[i], SDL_GetError());
+                continue;
+            }
+            engine.setPixmapFormat(surface);
+            char name[64];
+            snprintf(name, sizeof(name), "copy_sprite_pixmap_%dbpp", depths[i]);
+            CopySpritePixmap b(engine, ballArray, surface);
+            runner.measure(name, b, 32 * 32);
+            if (ColorKeyBlitter::canBlit(ballArray.getImage(0), surface))
+            {
+                // Same blits with SDL_BlitSurface() for comparison.
+                engine.setNativeBlits(false);
+                strcat(name, "_sdl");
+                runner.measure(name, b, 32 * 32);
+                engine.setNativeBlits(true);
+            }
+            engine.setPixmapFormat(NULL);
+            SDL_FreeSurface(surface);
+        }
+
+        {
+            // Off-screen sprites, e.g., in a scrolling level.
+            CopySpritePixmap b(engine, ballArray, NULL, Couple(SCREEN_WIDTH, 0));
+            runner.measure("copy_sprite_pixmap_culled", b);
+        }
+        {
+            SubmitSprites b(engine, ballArray);
+            runner.measure("draw_list_sprites", b, NUM_POINTS);
+        }
+        {
+            static const char text[] = "SCORE 0001234560";
+            WriteString b(engine, text);
+            runner.measure("write_string_cached", b, sizeof(text) - 1);
+            size_t budget = engine.getStringCacheBudget();
+            engine.setStringCacheBudget(0);
+            runner.measure("write_string_uncached", b, sizeof(text) - 1);
+            engine.setStringCacheBudget(budget);
+        }
+        {
+            DrawLine b(engine);
+            runner.measure("draw_line_wu", b);
+        }
+        {
+            DrawPixel b(engine);
+            runner.measure("draw_pixel", b);
+        }
+        {
+            DrawPixels b(engine);
+            runner.measure("draw_pixels_batch", b, NUM_POINTS);
+        }
+        {
+            FillRect b(engine, 8);
+            runner.measure("fill_rect_8x8", b, 8 * 8);
+        }
+        {
+            FillRect b(engine, 64);
+            runner.measure("fill_rect_64x64", b, 64 * 64);
+        }
+        {
+            TiledBackground background(Couple(SCREEN_WIDTH, SCREEN_HEIGHT),
+                                       ballArray);
+            ScrollBackground scrolling(engine, background, 4);
+            runner.measure("scroll_background_4px", scrolling,
+                           SCREEN_WIDTH * SCREEN_HEIGHT);
+            ScrollBackground redrawing(engine, background, 0);
+            runner.measure("scroll_background_full_redraw", redrawing,
+                           SCREEN_WIDTH * SCREEN_HEIGHT);
+        }
+        {
+            TileMap map(ballArray, Couple(32, 32), Couple(64, 64));
+            for (int row = 0; row < 64; row++)
+                for (int col = 0; col < 64; col++)
+                    map.setTile(col, row, 0);
+            DrawTileMap chunks(engine, map, ballArray, true);
+            runner.measure("tile_map_chunks", chunks,
+                           SCREEN_WIDTH * SCREEN_HEIGHT);
+            DrawTileMap perTile(engine, map, ballArray, false);
+            runner.measure("tile_map_per_tile", perTile,
+                           SCREEN_WIDTH * SCREEN_HEIGHT);
+        }
+    }
+    catch (const string &e)
+    {
+        fprintf(stderr, "%s: %s\n", argv[0], e.c_str());
+        return EXIT_FAILURE;
+    }
+    catch (const PixmapLoadError &e)
+    {
+        fprintf(stderr, "%s: failed to load pixmap (code %d)\n",
+                argv[0], int(e.getCode()));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
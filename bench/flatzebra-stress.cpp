@@ -0,0 +1,584 @@
+/*  $Id$
+    flatzebra-stress.cpp - Scaling test on a synthetic scene of sprites.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include "BenchmarkRunner.h"
+
+#include <flatzebra/GameEngine.h>
+#include <flatzebra/MonotonicClock.h>
+#include <flatzebra/SpriteGrid.h>
+#include <flatzebra/SweepAndPrune.h>
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+static const int SCREEN_WIDTH = 640;
+static const int SCREEN_HEIGHT = 480;
+static const int BALL_SIZE = 16;
+static const size_t NUM_ANIMATION_FRAMES = 4;
+static const int AREA_PER_OBJECT = 32 * 32;  // in square pixels
+
+static const char *ballRows[BALL_SIZE] =
+{
+    "     oooooo     ",
+    "   oooooooooo   ",
+    "  oooo....oooo  ",
+    " ooo........ooo ",
+    " oo..........oo ",
+    "ooo..........ooo",
+    "oo....xxxx....oo",
+    "oo....xxxx....oo",
+    "oo....xxxx....oo",
+    "oo....xxxx....oo",
+    "ooo..........ooo",
+    " oo..........oo ",
+    " ooo........ooo ",
+    "  oooo....oooo  ",
+    "   oooooooooo   ",
+    "     oooooo     ",
+};
+
+static const char *ballColors[NUM_ANIMATION_FRAMES][3] =
+{
+    { "o c #2040C0", ". c #E0E0FF", "x c #FFFF00" },
+    { "o c #3050D0", ". c #C0C0F0", "x c #FFC000" },
+    { "o c #4060E0", ". c #A0A0E0", "x c #FF8000" },
+    { "o c #3050D0", ". c #C0C0F0", "x c #FFC000" },
+};
+
+
+static Uint32 randomState = 12345;
+
+
+static int
+getRandom(int range)
+// Deterministic pseudo-random number in [0, range).
+{
+    randomState = randomState * 1103515245 + 12345;
+    return int((randomState >> 8) % Uint32(range));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+struct StressResult
+{
+    size_t numObjects;
+    size_t numFrames;
+    double meanMilliseconds;
+    double medianMilliseconds;
+    double p99Milliseconds;
+    double collisionsPerFrame;
+    double culledPerFrame;  // objects outside of the screen
+};
+
+
+class StressEngine : public GameEngine
+/*  Game that moves, collides, animates and draws a given number of
+    objects, with a HUD made of text and lines, and times its frames.
+
+    Half of the objects are Sprites, whose collisions are found with
+    a SpriteGrid, and half are RSprites, whose collisions are found
+    with a SweepAndPrune. Colliding objects exchange their speeds.
+    The objects live in a world whose area grows with their number,
+    so that the density, and thus the number of collisions per object,
+    stays roughly constant. Only the upper-left part of the world is
+    visible; the others are culled by the engine.
+*/
+{
+public:
+
+    StressEngine(bool headless) throw(string, PixmapLoadError);
+    virtual ~StressEngine();
+
+    StressResult runScene(size_t numObjects, size_t numWarmupFrames,
+                          size_t numFrames);
+    /*  Creates a scene of 'numObjects' objects, runs it for
+        'numWarmupFrames' + 'numFrames' frames with run(0), and
+        returns the statistics of the last 'numFrames' frames.
+    */
+
+    virtual void processKey(SDLKey key, bool pressed);
+    virtual bool tick();
+
+private:
+
+    void createObjects(size_t numObjects);
+    void destroyObjects();
+    void moveObjects();
+    void collideObjects();
+    void drawScene();
+
+    PixmapArray ballArray;
+    Couple worldSize;
+    SpriteList sprites;
+    RSpriteList rsprites;
+    SpriteGrid grid;
+    SweepAndPrune sweepAndPrune;
+    SpritePairList spritePairs;
+    RSpritePairList rspritePairs;
+    size_t numCollisions;  // during the measured frames
+    size_t frameNo;
+    size_t numWarmupFrames;
+    size_t numMeasuredFrames;
+    Uint64 lastTickTime;
+    vector<Uint64> frameTimes;  // in nanoseconds
+    bool quitRequested;
+
+    // Forbidden operations:
+    StressEngine(const StressEngine &);
+    StressEngine &operator = (const StressEngine &);
+};
+
+
+StressEngine::StressEngine(bool headless) throw(string, PixmapLoadError)
+  : GameEngine(Couple(SCREEN_WIDTH, SCREEN_HEIGHT), "flatzebra-stress",
+               false, false, headless),
+    ballArray(NUM_ANIMATION_FRAMES),
+    worldSize(),
+    sprites(),
+    rsprites(),
+    grid(32, 4096),
+    sweepAndPrune(),
+    spritePairs(),
+    rspritePairs(),
+    numCollisions(0),
+    frameNo(0),
+    numWarmupFrames(0),
+    numMeasuredFrames(0),
+    lastTickTime(0),
+    frameTimes(),
+    quitRequested(false)
+{
+    // One XPM per animation frame: same pixels, different colors.
+    for (size_t i = 0; i < NUM_ANIMATION_FRAMES; i++)
+    {
+        const char *data[1 + 4 + BALL_SIZE] =
+        {
+            "16 16 4 1", "  c None",
+            ballColors[i][0], ballColors[i][1], ballColors[i][2]
+        };
+        copy(ballRows, ballRows + BALL_SIZE, data + 5);
+        loadPixmap(data, ballArray, i);
+    }
+}
+
+
+StressEngine::~StressEngine()
+{
+    destroyObjects();
+}
+
+
+StressResult
+StressEngine::runScene(size_t numObjects, size_t numWarmup, size_t numFrames)
+{
+    createObjects(numObjects);
+    numCollisions = 0;
+    frameNo = 0;
+    numWarmupFrames = numWarmup;
+    numMeasuredFrames = numFrames;
+    frameTimes.clear();
+    frameTimes.reserve(numFrames);
+    lastTickTime = MonotonicClock::getNanoseconds();
+
+    run(0);  // returns when tick() returns false
+
+    StressResult result;
+    result.numObjects = numObjects;
+    result.numFrames = frameTimes.size();
+    result.meanMilliseconds = 0;
+    result.medianMilliseconds = 0;
+    result.p99Milliseconds = 0;
+    result.collisionsPerFrame = 0;
+    result.culledPerFrame = 0;
+    if (!frameTimes.empty())
+    {
+        Uint64 sum = 0;
+        for (size_t i = 0; i < frameTimes.size(); i++)
+            sum += frameTimes[i];
+        sort(frameTimes.begin(), frameTimes.end());
+        size_t n = frameTimes.size();
+        result.meanMilliseconds = double(sum) / double(n) / 1e6;
+        result.medianMilliseconds = double(frameTimes[n / 2]) / 1e6;
+        result.p99Milliseconds = double(frameTimes[(n - 1) * 99 / 100]) / 1e6;
+        result.collisionsPerFrame = double(numCollisions) / double(n);
+        result.culledPerFrame = double(getNumBlitsCulled()) / double(n);
+    }
+
+    destroyObjects();
+    return result;
+}
+
+
+void
+StressEngine::processKey(SDLKey key, bool pressed)
+{
+    if (key == SDLK_ESCAPE && pressed)
+        quitRequested = true;
+}
+
+
+bool
+StressEngine::tick()
+{
+    // A frame lasts from the start of one tick to the start of the next,
+    // so it includes the presentation and the event processing.
+    Uint64 now = MonotonicClock::getNanoseconds();
+    if (frameNo > numWarmupFrames)
+        frameTimes.push_back(now - lastTickTime);
+    lastTickTime = now;
+
+    if (quitRequested || frameNo == numWarmupFrames + numMeasuredFrames)
+        return false;
+    if (frameNo == numWarmupFrames)
+        resetBlitCounters();
+    frameNo++;
+
+    moveObjects();
+    collideObjects();
+    drawScene();
+    return true;
+}
+
+
+void
+StressEngine::createObjects(size_t numObjects)
+{
+    destroyObjects();
+
+    int side = int(sqrt(double(numObjects) * AREA_PER_OBJECT));
+    worldSize = Couple(max(side, SCREEN_WIDTH), max(side, SCREEN_HEIGHT));
+
+    const Couple collBoxPos(2, 2), collBoxSize(BALL_SIZE - 4, BALL_SIZE - 4);
+    for (size_t i = 0; i < numObjects; i++)
+    {
+        Couple pos(getRandom(worldSize.x - BALL_SIZE),
+                   getRandom(worldSize.y - BALL_SIZE));
+        Couple speed(getRandom(7) - 3, getRandom(7) - 3);
+        if (i % 2 == 0)
+            sprites.push_back(new Sprite(ballArray, pos, speed, Couple(),
+                                         collBoxPos, collBoxSize));
+        else
+            rsprites.push_back(new RSprite(ballArray, pos,
+                                    RCouple(speed) * 0.75, RCouple(),
+                                    collBoxPos, collBoxSize));
+    }
+
+    grid.insertSprites(sprites);
+    sweepAndPrune.addRSprites(rsprites);
+}
+
+
+void
+StressEngine::destroyObjects()
+{
+    grid.clear();
+    sweepAndPrune.clear();
+    for (size_t i = 0; i < sprites.size(); i++)
+        delete sprites[i];
+    for (size_t i = 0; i < rsprites.size(); i++)
+        delete rsprites[i];
+    sprites.clear();
+    rsprites.clear();
+}
+
+
+void
+StressEngine::moveObjects()
+{
+    const int maxX = worldSize.x - BALL_SIZE;
+    const int maxY = worldSize.y - BALL_SIZE;
+
+    for (SpriteList::iterator it = sprites.begin(); it != sprites.end(); ++it)
+    {
+        Sprite &s = **it;
+        s.addSpeedToPos();
+        Couple &pos = s.getPos(), &speed = s.getSpeed();
+        if ((pos.x < 0 && speed.x < 0) || (pos.x > maxX && speed.x > 0))
+            speed.x = -speed.x;
+        if ((pos.y < 0 && speed.y < 0) || (pos.y > maxY && speed.y > 0))
+            speed.y = -speed.y;
+    }
+
+    for (RSpriteList::iterator it = rsprites.begin(); it != rsprites.end(); ++it)
+    {
+        RSprite &s = **it;
+        s.addSpeedToPos();
+        RCouple &pos = s.getPos(), &speed = s.getSpeed();
+        if ((pos.x < 0 && speed.x < 0) || (pos.x > maxX && speed.x > 0))
+            speed.x = -speed.x;
+        if ((pos.y < 0 && speed.y < 0) || (pos.y > maxY && speed.y > 0))
+            speed.y = -speed.y;
+    }
+}
+
+
+void
+StressEngine::collideObjects()
+{
+    grid.updateAll();
+    spritePairs.clear();
+    grid.getCollidingPairs(spritePairs);
+    for (SpritePairList::iterator it = spritePairs.begin();
+                                            it != spritePairs.end(); ++it)
+    {
+        Couple speed = it->first->getSpeed();
+        it->first->setSpeed(it->second->getSpeed());
+        it->second->setSpeed(speed);
+    }
+
+    sweepAndPrune.update();
+    rspritePairs.clear();
+    sweepAndPrune.getCollidingPairs(rspritePairs);
+    for (RSpritePairList::iterator it = rspritePairs.begin();
+                                            it != rspritePairs.end(); ++it)
+    {
+        RCouple speed = it->first->getSpeed();
+        it->first->setSpeed(it->second->getSpeed());
+        it->second->setSpeed(speed);
+    }
+
+    if (frameNo > numWarmupFrames)
+        numCollisions += spritePairs.size() + rspritePairs.size();
+}
+
+
+void
+StressEngine::drawScene()
+{
+    fillRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0x000000);
+
+    size_t animationFrame = (frameNo / 4) % NUM_ANIMATION_FRAMES;
+    for (size_t i = 0; i < sprites.size(); i++)
+    {
+        const Sprite &s = *sprites[i];
+        submitSprite(s, (animationFrame + i) % NUM_ANIMATION_FRAMES,
+                     s.getPos(), 1);
+    }
+    for (size_t i = 0; i < rsprites.size(); i++)
+    {
+        const RSprite &s = *rsprites[i];
+        submitSprite(s, (animationFrame + i) % NUM_ANIMATION_FRAMES,
+                     s.getPos(), 2);  // over the Sprites
+    }
+    flushDrawList();  // the HUD goes over the balls
+
+    // Lines between the first colliding pairs, and a frame around the HUD.
+    enum { MAX_HUD_LINES = 64 };
+    Couple endPoints[2 * (MAX_HUD_LINES + 4)];
+    size_t n = 0;
+    for (size_t i = 0; i < spritePairs.size() && n < 2 * MAX_HUD_LINES; i++)
+    {
+        endPoints[n++] = spritePairs[i].first->getCenterPos();
+        endPoints[n++] = spritePairs[i].second->getCenterPos();
+    }
+    const Couple hudCorners[4] =
+    {
+        Couple(4, 4), Couple(260, 4), Couple(260, 40), Couple(4, 40)
+    };
+    for (size_t i = 0; i < 4; i++)
+    {
+        endPoints[n++] = hudCorners[i];
+        endPoints[n++] = hudCorners[(i + 1) % 4];
+    }
+    drawLines(endPoints, n, 0x00FF00);
+
+    char text[64];
+    snprintf(text, sizeof(text), "OBJECTS %lu", (unsigned long) (sprites.size()
+                                                        + rsprites.size()));
+    writeString(text, Couple(8, 8));
+    snprintf(text, sizeof(text), "FRAME %lu  HITS %lu",
+             (unsigned long) frameNo,
+             (unsigned long) (spritePairs.size() + rspritePairs.size()));
+    writeString(text, Couple(8, 24));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+static void
+writeHeader(FILE *out, BenchmarkRunner::Format format)
+{
+    if (format == BenchmarkRunner::CSV)
+        fprintf(out, "objects,frames,mean_frame_ms,median_frame_ms,"
+                     "p99_frame_ms,collisions_per_frame,culled_per_frame\n");
+    else
+        fprintf(out, "[\n");
+}
+
+
+static void
+writeResult(FILE *out, BenchmarkRunner::Format format,
+            const StressResult &r, bool first)
+{
+    if (format == BenchmarkRunner::CSV)
+        fprintf(out, "%lu,%lu,%.3f,%.3f,%.3f,%.1f,%.1f\n",
+                (unsigned long) r.numObjects, (unsigned long) r.numFrames,
+                r.meanMilliseconds, r.medianMilliseconds, r.p99Milliseconds,
+                r.collisionsPerFrame, r.culledPerFrame);
+    else
+        fprintf(out,
+                "%s  {\"objects\": %lu, \"frames\": %lu,"
+                " \"mean_frame_ms\": %.3f, \"median_frame_ms\": %.3f,"
+                " \"p99_frame_ms\": %.3f, \"collisions_per_frame\": %.1f,"
+                " \"culled_per_frame\": %.1f}",
+                first ? "" : ",\n",
+                (unsigned long) r.numObjects, (unsigned long) r.numFrames,
+                r.meanMilliseconds, r.medianMilliseconds, r.p99Milliseconds,
+                r.collisionsPerFrame, r.culledPerFrame);
+    fflush(out);
+}
+
+
+static void
+writeFooter(FILE *out, BenchmarkRunner::Format format, bool empty)
+{
+    if (format == BenchmarkRunner::JSON)
+        fprintf(out, "%s]\n", empty ? "" : "\n");
+}
+
+
+static void
+usage(const char *programName)
+{
+    fprintf(stderr,
+            "Usage: %s [--format=csv|json] [--min-objects=N] [--max-objects=N]\n"
+            "       [--frames=N] [--warmup=N] [--max-frame-ms=MS] [--window]\n"
+            "Runs a scene of moving, colliding and animated sprites for each\n"
+            "number of objects from --min-objects (default 100) to\n"
+            "--max-objects (default 100000) in a 1-2-5 sequence, and writes\n"
+            "the frame times on the standard output.\n"
+            "The sweep stops early when the mean frame time exceeds\n"
+            "--max-frame-ms (default 1000).\n"
+            "The scene is drawn in memory unless --window is given.\n",
+            programName);
+}
+
+
+static bool
+parseCount(const char *arg, const char *option, size_t &value)
+{
+    size_t len = strlen(option);
+    if (strncmp(arg, option, len) != 0)
+        return false;
+    value = size_t(strtoul(arg + len, NULL, 10));
+    return true;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    BenchmarkRunner::Format format = BenchmarkRunner::CSV;
+    size_t minObjects = 100, maxObjects = 100000;
+    size_t numFrames = 100, numWarmupFrames = 10;
+    double maxFrameMilliseconds = 1000;
+    bool headless = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--format=", 9) == 0)
+        {
+            if (!BenchmarkRunner::parseFormat(arg + 9, format))
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (parseCount(arg, "--min-objects=", minObjects)
+                || parseCount(arg, "--max-objects=", maxObjects)
+                || parseCount(arg, "--frames=", numFrames)
+                || parseCount(arg, "--warmup=", numWarmupFrames))
+            ;
+        else if (strncmp(arg, "--max-frame-ms=", 15) == 0)
+            maxFrameMilliseconds = atof(arg + 15);
+        else if (strcmp(arg, "--window") == 0)
+            headless = false;
+        else
+        {
+            usage(argv[0]);
+            return strcmp(arg, "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (minObjects == 0 || numFrames == 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        StressEngine engine(headless);
+
+        writeHeader(stdout, format);
+        bool first = true;
+
+        // 1-2-5 sequence: 100, 200, 500, 1000, ...
+        static const size_t steps[] = { 1, 2, 5 };
+        size_t decade = 1;
+        while (decade * 10 <= minObjects)
+            decade *= 10;
+        for (size_t step = 0; ; step = (step + 1) % 3)
+        {
+            size_t numObjects = decade * steps[step];
+            if (step == 2)
+                decade *= 10;
+            if (numObjects < minObjects)
+                continue;
+            if (numObjects > maxObjects)
+                break;
+
+            StressResult r = engine.runScene(numObjects, numWarmupFrames,
+                                             numFrames);
+            writeResult(stdout, format, r, first);
+            first = false;
+            if (r.numFrames < numFrames  // interrupted by the user
+                    || r.meanMilliseconds > maxFrameMilliseconds)
+                break;
+        }
+
+        writeFooter(stdout, format, first);
+    }
+    catch (const string &e)
+    {
+        fprintf(stderr, "%s: %s\n", argv[0], e.c_str());
+        return EXIT_FAILURE;
+    }
+    catch (const PixmapLoadError &e)
+    {
+        fprintf(stderr, "%s: failed to load pixmap (code %d)\n",
+                argv[0], int(e.getCode()));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
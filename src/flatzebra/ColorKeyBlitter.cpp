@@ -0,0 +1,217 @@
+/*  $Id$
+    ColorKeyBlitter.cpp - Blitter for small color-keyed sprites.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/ColorKeyBlitter.h>
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLATZEBRA_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace flatzebra;
+
+
+namespace {
+
+
+/*  Copies 'width' pixels from 'src' to 'dst', except those whose
+    bits in 'keyMask' equal 'key'.
+*/
+
+void
+copyRow16(const Uint16 *src, Uint16 *dst, int width, Uint16 key, Uint16 keyMask)
+{
+    int x = 0;
+    #ifdef FLATZEBRA_SSE2
+    const __m128i keys = _mm_set1_epi16(Sint16(key));
+    const __m128i masks = _mm_set1_epi16(Sint16(keyMask));
+    for ( ; x + 8 <= width; x += 8)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + x));
+        __m128i d = _mm_loadu_si128((const __m128i *) (dst + x));
+        __m128i transparent = _mm_cmpeq_epi16(_mm_and_si128(s, masks), keys);
+        d = _mm_or_si128(_mm_and_si128(transparent, d),
+                         _mm_andnot_si128(transparent, s));
+        _mm_storeu_si128((__m128i *) (dst + x), d);
+    }
+    #endif
+    for ( ; x < width; x++)
+        if ((src[x] & keyMask) != key)
+            dst[x] = src[x];
+}
+
+
+void
+copyRow32(const Uint32 *src, Uint32 *dst, int width, Uint32 key, Uint32 keyMask)
+{
+    int x = 0;
+    #ifdef FLATZEBRA_SSE2
+    const __m128i keys = _mm_set1_epi32(Sint32(key));
+    const __m128i masks = _mm_set1_epi32(Sint32(keyMask));
+    for ( ; x + 4 <= width; x += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + x));
+        __m128i d = _mm_loadu_si128((const __m128i *) (dst + x));
+        __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(s, masks), keys);
+        d = _mm_or_si128(_mm_and_si128(transparent, d),
+                         _mm_andnot_si128(transparent, s));
+        _mm_storeu_si128((__m128i *) (dst + x), d);
+    }
+    #endif
+    for ( ; x < width; x++)
+        if ((src[x] & keyMask) != key)
+            dst[x] = src[x];
+}
+
+
+}  // anonymous namespace
+
+
+/*static*/
+bool
+ColorKeyBlitter::canBlit(const SDL_Surface *src, const SDL_Surface *dst) throw()
+{
+    if (src == NULL || dst == NULL)
+        return false;
+    const SDL_PixelFormat *sf = src->format, *df = dst->format;
+    if (sf->BytesPerPixel != df->BytesPerPixel
+            || (sf->BytesPerPixel != 2 && sf->BytesPerPixel != 4))
+        return false;
+    if (sf->Rmask != df->Rmask || sf->Gmask != df->Gmask
+            || sf->Bmask != df->Bmask || sf->Amask != df->Amask)
+        return false;
+    if ((src->flags & (SDL_RLEACCEL | SDL_SRCALPHA)) != 0)
+        return false;
+    return !SDL_MUSTLOCK(src) && !SDL_MUSTLOCK(dst);
+}
+
+
+/*static*/
+bool
+ColorKeyBlitter::blit(SDL_Surface *src, const SDL_Rect *srcrect,
+                      SDL_Surface *dst, SDL_Rect *dstrect) throw()
+{
+    if (!canBlit(src, dst))
+        return false;
+    blitUnchecked(src, srcrect, dst, dstrect);
+    return true;
+}
+
+
+/*static*/
+void
+ColorKeyBlitter::blitUnchecked(SDL_Surface *src, const SDL_Rect *srcrect,
+                               SDL_Surface *dst, SDL_Rect *dstrect) throw()
+{
+    // Clip as SDL_UpperBlit() does, in int to avoid overflows.
+    int srcX = 0, srcY = 0, width = src->w, height = src->h;
+    int dstX = (dstrect != NULL ? dstrect->x : 0);
+    int dstY = (dstrect != NULL ? dstrect->y : 0);
+    if (srcrect != NULL)
+    {
+        srcX = srcrect->x;
+        srcY = srcrect->y;
+        width = srcrect->w;
+        height = srcrect->h;
+        if (srcX < 0)
+        {
+            width += srcX;
+            dstX -= srcX;
+            srcX = 0;
+        }
+        if (srcY < 0)
+        {
+            height += srcY;
+            dstY -= srcY;
+            srcY = 0;
+        }
+        if (width > src->w - srcX)
+            width = src->w - srcX;
+        if (height > src->h - srcY)
+            height = src->h - srcY;
+    }
+
+    const SDL_Rect &clip = dst->clip_rect;
+    int d = clip.x - dstX;
+    if (d > 0)
+    {
+        width -= d;
+        dstX += d;
+        srcX += d;
+    }
+    d = dstX + width - (clip.x + clip.w);
+    if (d > 0)
+        width -= d;
+    d = clip.y - dstY;
+    if (d > 0)
+    {
+        height -= d;
+        dstY += d;
+        srcY += d;
+    }
+    d = dstY + height - (clip.y + clip.h);
+    if (d > 0)
+        height -= d;
+
+    if (width <= 0 || height <= 0)
+    {
+        if (dstrect != NULL)
+            dstrect->w = dstrect->h = 0;
+        return;
+    }
+    if (dstrect != NULL)
+    {
+        dstrect->x = Sint16(dstX);
+        dstrect->y = Sint16(dstY);
+        dstrect->w = Uint16(width);
+        dstrect->h = Uint16(height);
+    }
+
+    const SDL_PixelFormat *fmt = src->format;
+    const int bpp = fmt->BytesPerPixel;
+    const Uint8 *srcRow = (const Uint8 *) src->pixels
+                                + srcY * src->pitch + srcX * bpp;
+    Uint8 *dstRow = (Uint8 *) dst->pixels + dstY * dst->pitch + dstX * bpp;
+
+    if ((src->flags & SDL_SRCCOLORKEY) == 0)  // opaque: plain copy
+    {
+        for (int y = 0; y < height; y++, srcRow += src->pitch, dstRow += dst->pitch)
+            memcpy(dstRow, srcRow, size_t(width * bpp));
+        return;
+    }
+
+    // Like SDL, ignore the alpha channel when comparing with the key.
+    Uint32 keyMask = ~fmt->Amask;
+    Uint32 key = fmt->colorkey & keyMask;
+    if (bpp == 2)
+        for (int y = 0; y < height; y++, srcRow += src->pitch, dstRow += dst->pitch)
+            copyRow16((const Uint16 *) srcRow, (Uint16 *) dstRow, width,
+                      Uint16(key), Uint16(keyMask));
+    else
+        for (int y = 0; y < height; y++, srcRow += src->pitch, dstRow += dst->pitch)
+            copyRow32((const Uint32 *) srcRow, (Uint32 *) dstRow, width,
+                      key, keyMask);
+}
@@ -0,0 +1,89 @@
+/*  $Id$
+    ColorKeyBlitter.h - Blitter for small color-keyed sprites.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_ColorKeyBlitter
+#define _H_ColorKeyBlitter
+
+#include <SDL.h>
+
+
+namespace flatzebra {
+
+
+class ColorKeyBlitter
+/*  Copies a rectangle of a surface onto another surface of the same
+    16-bit or 32-bit pixel format, skipping the pixels of the source's
+    color key, if it has one.
+    For the small sprites of a typical game, the per-call work of
+    SDL_BlitSurface() (validation of the blit mapping, choice of the
+    blit function) costs more than copying the pixels. This blitter
+    clips once and compares 8 (16-bit) or 4 (32-bit) pixels at a time
+    with the color key when SSE2 is available.
+    It does not handle RLE-accelerated sources, whose pixels are
+    encoded, nor alpha blending: blit() returns false for those, and
+    the caller must then use SDL_BlitSurface().
+*/
+{
+public:
+
+    enum { MAX_SPRITE_WIDTH = 64 };
+    /*  Width in pixels above which GameEngine leaves the blits to
+        SDL_BlitSurface(), whose RLE acceleration skips the transparent
+        runs of large images instead of comparing every pixel.
+        PixmapArray does not RLE-encode the narrower images, so that
+        they remain blittable by this class.
+    */
+
+    static bool canBlit(const SDL_Surface *src, const SDL_Surface *dst) throw();
+    /*  Indicates if blit() can copy 'src' onto 'dst': both must have the
+        same 16-bit or 32-bit format, not need locking, and 'src' must
+        not be RLE-accelerated nor use alpha blending.
+    */
+
+    static bool blit(SDL_Surface *src, const SDL_Rect *srcrect,
+                     SDL_Surface *dst, SDL_Rect *dstrect) throw();
+    /*  Same arguments and clipping as SDL_BlitSurface(): 'srcrect' is
+        the area to copy (all of 'src' if null), the position is taken
+        from 'dstrect', and 'dstrect' receives the clipped destination
+        rectangle.
+        Returns false without doing anything if canBlit() is false.
+    */
+
+    static void blitUnchecked(SDL_Surface *src, const SDL_Rect *srcrect,
+                              SDL_Surface *dst, SDL_Rect *dstrect) throw();
+    /*  Same as blit(), but canBlit(src, dst) must be true.
+        For callers that blit the same source many times.
+    */
+
+private:
+
+    /*  Forbidden operations:
+    */
+    ColorKeyBlitter();
+};
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_ColorKeyBlitter */
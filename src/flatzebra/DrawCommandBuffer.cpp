@@ -0,0 +1,196 @@
+/*  $Id$
+    DrawCommandBuffer.cpp - Recorded drawing operations on the screen.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/DrawCommandBuffer.h>
+
+#include <assert.h>
+#include <string.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+DrawCommandBuffer::DrawCommandBuffer()
+  : commands(),
+    ints(),
+    text()
+{
+}
+
+
+void
+DrawCommandBuffer::clear()
+{
+    commands.clear();
+    ints.clear();
+    text.clear();
+}
+
+
+DrawCommandBuffer::Command &
+DrawCommandBuffer::addCommand(CommandType type)
+{
+    commands.push_back(Command());
+    Command &c = commands.back();
+    c.type = type;
+    c.source = NULL;
+    c.sourceRect.x = c.sourceRect.y = 0;
+    c.sourceRect.w = c.sourceRect.h = 0;
+    c.x = c.y = c.width = c.height = 0;
+    c.color = 0;
+    c.first = c.count = 0;
+    return c;
+}
+
+
+void
+DrawCommandBuffer::addBlit(SDL_Surface *source, const SDL_Rect *sourceRect,
+                           int x, int y)
+{
+    Command &c = addCommand(BLIT);
+    c.source = source;
+    if (sourceRect != NULL)
+        c.sourceRect = *sourceRect;
+    c.x = x;
+    c.y = y;
+}
+
+
+void
+DrawCommandBuffer::addFillRect(int x, int y, int width, int height, Uint32 color)
+{
+    Command &c = addCommand(FILL_RECT);
+    c.x = x;
+    c.y = y;
+    c.width = width;
+    c.height = height;
+    c.color = color;
+}
+
+
+void
+DrawCommandBuffer::addPixels(const Couple *points, size_t numPoints, Uint32 color,
+                             Couple offset)
+{
+    Command &c = addCommand(PIXELS);
+    c.color = color;
+    c.first = ints.size();
+    c.count = numPoints;
+    for (size_t i = 0; i < numPoints; i++)
+    {
+        ints.push_back(points[i].x + offset.x);
+        ints.push_back(points[i].y + offset.y);
+    }
+}
+
+
+void
+DrawCommandBuffer::addSpans(Uint32 color)
+{
+    Command &c = addCommand(SPANS);
+    c.color = color;
+    c.first = ints.size();
+}
+
+
+void
+DrawCommandBuffer::addSpan(int x, int y, int width)
+{
+    assert(!commands.empty() && commands.back().type == SPANS);
+    ints.push_back(x);
+    ints.push_back(y);
+    ints.push_back(width);
+    commands.back().count++;
+}
+
+
+void
+DrawCommandBuffer::addLines(const Couple *endPoints, size_t numEndPoints, Uint32 color,
+                            Couple offset)
+{
+    addPixels(endPoints, numEndPoints, color, offset);
+    commands.back().type = LINES;
+}
+
+
+void
+DrawCommandBuffer::addText(const char *s, int x, int y)
+{
+    Command &c = addCommand(TEXT);
+    c.x = x;
+    c.y = y;
+    c.first = text.size();
+    c.count = strlen(s);
+    text.insert(text.end(), s, s + c.count + 1);  // include the terminating '\0'
+}
+
+
+void
+DrawCommandBuffer::addDirtyRect(int x, int y, int width, int height)
+{
+    Command &c = addCommand(DIRTY_RECT);
+    c.x = x;
+    c.y = y;
+    c.width = width;
+    c.height = height;
+}
+
+
+void
+DrawCommandBuffer::addClipRect(int x, int y, int width, int height)
+{
+    Command &c = addCommand(CLIP_RECT);
+    c.x = x;
+    c.y = y;
+    c.width = width;
+    c.height = height;
+}
+
+
+void
+DrawCommandBuffer::append(const DrawCommandBuffer &other)
+{
+    size_t intOffset = ints.size(), textOffset = text.size();
+    ints.insert(ints.end(), other.ints.begin(), other.ints.end());
+    text.insert(text.end(), other.text.begin(), other.text.end());
+
+    size_t n = commands.size();
+    commands.insert(commands.end(), other.commands.begin(), other.commands.end());
+    for ( ; n < commands.size(); n++)
+    {
+        Command &c = commands[n];
+        if (c.type == TEXT)
+            c.first += textOffset;
+        else if (c.type == PIXELS || c.type == SPANS || c.type == LINES)
+            c.first += intOffset;
+    }
+}
+
+
+void
+DrawCommandBuffer::swap(DrawCommandBuffer &other)
+{
+    commands.swap(other.commands);
+    ints.swap(other.ints);
+    text.swap(other.text);
+}
@@ -0,0 +1,173 @@
+/*  $Id$
+    DrawCommandBuffer.h - Recorded drawing operations on the screen.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_DrawCommandBuffer
+#define _H_DrawCommandBuffer
+
+#include <flatzebra/Couple.h>
+
+#include <SDL.h>
+
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class DrawCommandBuffer
+/*  Sequence of drawing operations on the screen, recorded so that
+    they can be performed later, typically on another thread.
+    Used by GameEngine::runThreaded().
+
+    The buffer owns copies of the texts and point lists given to it.
+    It does not own the source surfaces of the blits: these must remain
+    valid until the buffer has been played back.
+*/
+{
+public:
+
+    enum CommandType
+    {
+        BLIT,
+        FILL_RECT,
+        PIXELS,
+        SPANS,
+        LINES,
+        TEXT,
+        DIRTY_RECT,
+        CLIP_RECT
+    };
+
+    struct Command
+    {
+        CommandType type;
+        SDL_Surface *source;  // BLIT only
+        SDL_Rect sourceRect;  // BLIT only; w == 0 means the whole source
+        int x, y, width, height;  // destination (width, height: FILL_RECT, DIRTY_RECT, CLIP_RECT)
+        Uint32 color;
+        size_t first, count;  // range in getInts() or getText()
+    };
+
+    DrawCommandBuffer();
+
+    void clear();
+    /*  Removes all commands, but keeps the allocated memory.
+    */
+
+    bool empty() const;
+    size_t size() const;
+    const Command &operator [] (size_t i) const;
+
+    void addBlit(SDL_Surface *source, const SDL_Rect *sourceRect, int x, int y);
+    void addFillRect(int x, int y, int width, int height, Uint32 color);
+    void addPixels(const Couple *points, size_t numPoints, Uint32 color,
+                   Couple offset = Couple());
+    void addSpans(Uint32 color);
+    void addSpan(int x, int y, int width);
+    void addLines(const Couple *endPoints, size_t numEndPoints, Uint32 color,
+                  Couple offset = Couple());
+    void addText(const char *s, int x, int y);
+    void addDirtyRect(int x, int y, int width, int height);
+    void addClipRect(int x, int y, int width, int height);
+    /*  Record the corresponding drawing operation.
+        addSpans() records an empty list of spans, to which each call
+        to addSpan() adds one span.
+        addPixels() and addLines() add 'offset' to each point.
+        addClipRect() records a call to SDL_SetClipRect() on the screen.
+        Coordinates are stored in getInts() as consecutive values:
+        (x, y) pairs for PIXELS and LINES, (x, y, width) triples for SPANS.
+    */
+
+    void append(const DrawCommandBuffer &other);
+    /*  Adds the commands of 'other' after those of this buffer.
+    */
+
+    void swap(DrawCommandBuffer &other);
+    /*  Exchanges the contents of the two buffers in constant time.
+    */
+
+    const int *getInts() const;
+    const char *getText() const;
+    /*  Storage of the coordinates and of the zero-terminated texts
+        referred to by Command::first.
+    */
+
+private:
+
+    Command &addCommand(CommandType type);
+
+    std::vector<Command> commands;
+    std::vector<int> ints;
+    std::vector<char> text;
+
+    /*  Forbidden operations:
+    */
+    DrawCommandBuffer(const DrawCommandBuffer &);
+    DrawCommandBuffer &operator = (const DrawCommandBuffer &);
+};
+
+
+inline
+bool
+DrawCommandBuffer::empty() const
+{
+    return commands.empty();
+}
+
+
+inline
+size_t
+DrawCommandBuffer::size() const
+{
+    return commands.size();
+}
+
+
+inline
+const DrawCommandBuffer::Command &
+DrawCommandBuffer::operator [] (size_t i) const
+{
+    return commands[i];
+}
+
+
+inline
+const int *
+DrawCommandBuffer::getInts() const
+{
+    return ints.empty() ? NULL : &ints[0];
+}
+
+
+inline
+const char *
+DrawCommandBuffer::getText() const
+{
+    return text.empty() ? NULL : &text[0];
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_DrawCommandBuffer */
@@ -0,0 +1,136 @@
+/*  $Id$
+    DrawList.cpp - Blits of a frame, sorted by layer and source surface.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/DrawList.h>
+
+#include <string.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+DrawList::DrawList()
+  : entries(),
+    keys(),
+    surfaceNumbers(),
+    lastSurface(NULL),
+    lastSurfaceNumber(0),
+    items(),
+    tempItems(),
+    sortedEntries()
+{
+}
+
+
+void
+DrawList::add(SDL_Surface *image, const SDL_Rect &srcrect,
+              int x, int y, const SDL_Rect &clip, int layer)
+{
+    if (layer < MIN_LAYER)
+        layer = MIN_LAYER;
+    else if (layer > MAX_LAYER)
+        layer = MAX_LAYER;
+
+    Entry e;
+    e.image = image;
+    e.srcrect = srcrect;
+    e.x = x;
+    e.y = y;
+    e.clip = clip;
+    entries.push_back(e);
+    keys.push_back((Uint32(layer - MIN_LAYER) << 16) | getSurfaceNumber(image));
+}
+
+
+Uint32
+DrawList::getSurfaceNumber(SDL_Surface *image)
+{
+    // Consecutive entries often come from the same surface.
+    if (image == lastSurface && !surfaceNumbers.empty())
+        return lastSurfaceNumber;
+
+    map<SDL_Surface *, Uint32>::iterator it = surfaceNumbers.find(image);
+    if (it == surfaceNumbers.end())
+    {
+        // Beyond 65536 surfaces, the last ones share a number.
+        Uint32 n = Uint32(surfaceNumbers.size());
+        it = surfaceNumbers.insert(make_pair(image, n < 0xFFFF ? n : 0xFFFF)).first;
+    }
+    lastSurface = image;
+    lastSurfaceNumber = it->second;
+    return lastSurfaceNumber;
+}
+
+
+void
+DrawList::sort()
+{
+    const size_t n = entries.size();
+    items.resize(n);
+    tempItems.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        items[i].key = keys[i];
+        items[i].index = Uint32(i);
+    }
+
+    // Least significant digit first, one byte per pass.
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        size_t counts[256];
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < n; i++)
+            counts[(items[i].key >> shift) & 0xFF]++;
+        if (n == 0 || counts[(items[0].key >> shift) & 0xFF] == n)
+            continue;  // all the same digit: nothing to reorder
+
+        size_t total = 0;
+        for (size_t d = 0; d < 256; d++)
+        {
+            size_t count = counts[d];
+            counts[d] = total;  // now the first position of digit d
+            total += count;
+        }
+        for (size_t i = 0; i < n; i++)
+            tempItems[counts[(items[i].key >> shift) & 0xFF]++] = items[i];
+        items.swap(tempItems);
+    }
+
+    sortedEntries.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        sortedEntries[i] = entries[items[i].index];
+        keys[i] = items[i].key;
+    }
+    entries.swap(sortedEntries);
+}
+
+
+void
+DrawList::clear()
+{
+    entries.clear();
+    keys.clear();
+    surfaceNumbers.clear();
+    lastSurface = NULL;
+}
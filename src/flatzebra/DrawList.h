@@ -0,0 +1,131 @@
+/*  $Id$
+    DrawList.h - Blits of a frame, sorted by layer and source surface.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_DrawList
+#define _H_DrawList
+
+#include <SDL.h>
+
+#include <map>
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class DrawList
+/*  List of the blits submitted during a frame, to be sorted by layer,
+    then by source surface, before being performed in one pass.
+    Entries from the same source surface are adjacent after sort(),
+    so that the blitter can be chosen once for all of them, and sprites
+    of a PixmapAtlas page are drawn together.
+    See GameEngine::submitSprite().
+*/
+{
+public:
+
+    struct Entry
+    {
+        SDL_Surface *image;
+        SDL_Rect srcrect;
+        int x, y;  // destination
+        SDL_Rect clip;  // clipping rectangle of the destination
+    };
+
+    enum { MIN_LAYER = -32768, MAX_LAYER = 32767 };
+
+    DrawList();
+
+    void add(SDL_Surface *image, const SDL_Rect &srcrect,
+             int x, int y, const SDL_Rect &clip, int layer);
+    /*  Appends a blit of 'srcrect' of 'image' at (x, y), to be clipped
+        to 'clip' whatever the clipping rectangle is when it is performed.
+        'layer' is clamped to [MIN_LAYER, MAX_LAYER].
+    */
+
+    void sort();
+    /*  Sorts the entries by increasing layer, then by source surface
+        in the order in which the surfaces were first added.
+        The sort is stable: entries that have the same layer and source
+        keep the order in which they were added.
+        This is a radix sort, linear in the number of entries.
+    */
+
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    const Entry &operator [] (size_t i) const;
+
+private:
+
+    struct SortItem
+    {
+        Uint32 key;  // layer in the high 16 bits, surface number in the low
+        Uint32 index;  // in 'entries'
+    };
+
+    Uint32 getSurfaceNumber(SDL_Surface *image);
+
+    std::vector<Entry> entries;
+    std::vector<Uint32> keys;  // same size as 'entries'
+    std::map<SDL_Surface *, Uint32> surfaceNumbers;  // since the last clear()
+    SDL_Surface *lastSurface;  // cache for getSurfaceNumber()
+    Uint32 lastSurfaceNumber;
+    std::vector<SortItem> items, tempItems;  // used by sort()
+    std::vector<Entry> sortedEntries;  // used by sort()
+
+    /*  Forbidden operations:
+    */
+    DrawList(const DrawList &);
+    DrawList &operator = (const DrawList &);
+};
+
+
+inline
+bool
+DrawList::empty() const
+{
+    return entries.empty();
+}
+
+
+inline
+size_t
+DrawList::size() const
+{
+    return entries.size();
+}
+
+
+inline
+const DrawList::Entry &
+DrawList::operator [] (size_t i) const
+{
+    return entries[i];
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_DrawList */
@@ -0,0 +1,167 @@
+/*  $Id$
+    FramePacer.cpp - Waits for frame deadlines with sub-millisecond accuracy.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/FramePacer.h>
+
+#include <flatzebra/MonotonicClock.h>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+static const Uint64 MS = 1000000;  // nanoseconds per millisecond
+static const Uint64 INITIAL_SPIN_MARGIN = 2 * MS;
+static const Uint64 MAX_SPIN_MARGIN = 2 * MS;  // bounds the CPU time spent yielding
+
+
+FramePacer::FramePacer(size_t historySize)
+  : framePeriod(0),
+    nextDeadline(0),
+    spinMargin(INITIAL_SPIN_MARGIN),
+    errors(historySize, 0),
+    nextError(0),
+    numErrors(0)
+{
+    assert(historySize > 0);
+}
+
+
+void
+FramePacer::setFramePeriod(Uint64 nanoseconds)
+{
+    framePeriod = nanoseconds;
+    restart();
+}
+
+
+void
+FramePacer::restart()
+{
+    nextDeadline = MonotonicClock::getNanoseconds() + framePeriod;
+}
+
+
+void
+FramePacer::waitForNextFrame()
+{
+    if (framePeriod == 0)
+        return;
+
+    sleepUntil(nextDeadline);
+
+    Uint64 now = MonotonicClock::getNanoseconds();
+    Uint64 lateness = (now > nextDeadline ? now - nextDeadline : 0);
+    recordError(lateness);
+
+    if (lateness > framePeriod)
+        nextDeadline = now + framePeriod;  // give up on the missed frames
+    else
+        nextDeadline += framePeriod;
+}
+
+
+void
+FramePacer::sleepUntil(Uint64 deadline)
+{
+    Uint64 now = MonotonicClock::getNanoseconds();
+
+    // Coarse sleep, in whole milliseconds, up to the margin.
+    if (now + spinMargin + MS <= deadline)
+    {
+        Uint32 requested = Uint32((deadline - spinMargin - now) / MS);
+        SDL_Delay(requested);
+        Uint64 after = MonotonicClock::getNanoseconds();
+
+        // Calibrate the margin from the oversleep.
+        Uint64 slept = after - now, expected = requested * MS;
+        Uint64 oversleep = (slept > expected ? slept - expected : 0);
+        if (oversleep > spinMargin)
+            spinMargin = min(oversleep, MAX_SPIN_MARGIN);
+        else
+            spinMargin -= (spinMargin - oversleep) / 16;
+        now = after;
+    }
+
+    // Fine wait: yield the processor until the deadline.
+    while (now < deadline)
+    {
+        SDL_Delay(0);
+        now = MonotonicClock::getNanoseconds();
+    }
+}
+
+
+void
+FramePacer::recordError(Uint64 lateness)
+{
+    errors[nextError] = lateness;
+    nextError = (nextError + 1) % errors.size();
+    if (numErrors < errors.size())
+        numErrors++;
+}
+
+
+Uint64
+FramePacer::getMeanError() const
+{
+    if (numErrors == 0)
+        return 0;
+    Uint64 sum = 0;
+    for (size_t i = 0; i < numErrors; i++)
+        sum += errors[i];
+    return sum / numErrors;
+}
+
+
+Uint64
+FramePacer::getP99Error() const
+{
+    if (numErrors == 0)
+        return 0;
+    vector<Uint64> sorted(errors.begin(), errors.begin() + numErrors);
+    size_t k = (numErrors - 1) * 99 / 100;
+    nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+
+Uint64
+FramePacer::getMaxError() const
+{
+    if (numErrors == 0)
+        return 0;
+    return *max_element(errors.begin(), errors.begin() + numErrors);
+}
+
+
+void
+FramePacer::clearStatistics()
+{
+    nextError = 0;
+    numErrors = 0;
+}
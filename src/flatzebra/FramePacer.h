@@ -0,0 +1,150 @@
+/*  $Id$
+    FramePacer.h - Waits for frame deadlines with sub-millisecond accuracy.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_FramePacer
+#define _H_FramePacer
+
+#include <SDL_types.h>
+
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class FramePacer
+/*  Paces a loop so that each of its iterations starts on a regular
+    schedule, e.g., 60 or 120 frames per second.
+
+    SDL_Delay() typically oversleeps by one to several milliseconds.
+    This class therefore sleeps with SDL_Delay() until a safety margin
+    before the deadline, then yields the processor in a loop until the
+    deadline. The margin follows the oversleep measured after each
+    SDL_Delay() call: it grows immediately when a larger oversleep is
+    observed and shrinks slowly otherwise.
+    The margin never exceeds 2 ms, so that the yielding loop keeps the
+    processor busy for a small part of each frame; on a system that
+    oversleeps by more than that, frames are late instead.
+
+    The lateness of each frame with respect to its deadline is recorded
+    in a history from which statistics can be obtained.
+*/
+{
+public:
+
+    FramePacer(size_t historySize = 256);
+    /*  Creates a pacer with a period of zero (no waiting).
+        'historySize' is the number of most recent frames over which
+        the statistics are computed. Must be positive.
+    */
+
+    void setFramePeriod(Uint64 nanoseconds);
+    Uint64 getFramePeriod() const;
+    /*  Period between two frame deadlines, in nanoseconds.
+        Setting the period restarts the schedule from the current time.
+    */
+
+    void restart();
+    /*  Restarts the schedule: the next deadline becomes the current time
+        plus the frame period.
+    */
+
+    void waitForNextFrame();
+    /*  Waits until the next deadline, then advances the deadline by
+        one period.
+        If the frame was already late by more than one period, the
+        schedule is restarted from the current time, so that a stall
+        is not followed by a burst of frames.
+        Does nothing if the period is zero.
+    */
+
+    Uint64 getSpinMargin() const;
+    /*  Current margin before a deadline, in nanoseconds, under which
+        SDL_Delay() is not used. At most 2 ms.
+    */
+
+    size_t getNumFrames() const;
+    /*  Number of frames recorded in the statistics history (at most
+        the history size given to the constructor).
+    */
+
+    Uint64 getMeanError() const;
+    Uint64 getP99Error() const;
+    Uint64 getMaxError() const;
+    /*  Mean, 99th percentile and maximum lateness, in nanoseconds,
+        of the frames in the statistics history.
+        Return zero if no frames have been recorded.
+        getP99Error() takes time proportional to the history size.
+    */
+
+    void clearStatistics();
+    /*  Empties the statistics history.
+    */
+
+private:
+
+    void sleepUntil(Uint64 deadline);
+    void recordError(Uint64 lateness);
+
+    Uint64 framePeriod;
+    Uint64 nextDeadline;
+    Uint64 spinMargin;
+    std::vector<Uint64> errors;  // ring buffer of latenesses
+    size_t nextError;  // index in 'errors' of the next lateness to record
+    size_t numErrors;  // number of valid elements in 'errors'
+
+    /*  Forbidden operations:
+    */
+    FramePacer(const FramePacer &);
+    FramePacer &operator = (const FramePacer &);
+};
+
+
+inline
+Uint64
+FramePacer::getFramePeriod() const
+{
+    return framePeriod;
+}
+
+
+inline
+Uint64
+FramePacer::getSpinMargin() const
+{
+    return spinMargin;
+}
+
+
+inline
+size_t
+FramePacer::getNumFrames() const
+{
+    return numErrors;
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_FramePacer */
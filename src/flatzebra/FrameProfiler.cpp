@@ -0,0 +1,202 @@
+/*  $Id$
+    FrameProfiler.cpp - Per-frame timing of the phases of the main loop.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/FrameProfiler.h>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+static const char *builtInPhaseNames[FrameProfiler::NUM_BUILT_IN_PHASES] =
+{
+    "events",
+    "tick",
+    "render",
+    "blit",
+    "text",
+    "present",
+    "wait",
+};
+
+
+FrameProfiler::FrameProfiler()
+  : enabled(false),
+    threadID(0),
+    phases(),
+    nestedTimes(),
+    frameStart(0),
+    nextFrame(0),
+    numFrames(0)
+{
+    for (size_t i = 0; i < NUM_BUILT_IN_PHASES; i++)
+        registerPhase(builtInPhaseNames[i]);
+    memset(frameHistory, 0, sizeof(frameHistory));
+}
+
+
+void
+FrameProfiler::setEnabled(bool enable)
+{
+    enabled = enable;
+    frameStart = 0;  // the current frame, if any, is not recorded
+}
+
+
+size_t
+FrameProfiler::registerPhase(const char *name)
+{
+    assert(name != NULL);
+    for (size_t i = 0; i < phases.size(); i++)
+        if (strcmp(phases[i].name, name) == 0)
+            return i;
+
+    phases.push_back(Phase());
+    Phase &ph = phases.back();
+    ph.name = name;
+    ph.current = 0;
+    memset(ph.history, 0, sizeof(ph.history));
+    return phases.size() - 1;
+}
+
+
+void
+FrameProfiler::beginFrame()
+{
+    if (!enabled)
+        return;
+    threadID = SDL_ThreadID();
+    for (vector<Phase>::iterator it = phases.begin(); it != phases.end(); ++it)
+        it->current = 0;
+    frameStart = MonotonicClock::getNanoseconds();
+}
+
+
+void
+FrameProfiler::endFrame()
+{
+    if (!enabled || frameStart == 0)
+        return;
+
+    frameHistory[nextFrame] = MonotonicClock::getNanoseconds() - frameStart;
+    for (vector<Phase>::iterator it = phases.begin(); it != phases.end(); ++it)
+        it->history[nextFrame] = it->current;
+
+    nextFrame = (nextFrame + 1) % HISTORY_SIZE;
+    if (numFrames < HISTORY_SIZE)
+        numFrames++;
+    frameStart = 0;
+}
+
+
+void
+FrameProfiler::addTime(size_t phase, Uint64 nanoseconds)
+{
+    assert(phase < phases.size());
+    if (frameStart != 0 && SDL_ThreadID() == threadID)
+        phases[phase].current += nanoseconds;
+}
+
+
+Uint64
+FrameProfiler::beginScope()
+{
+    if (frameStart == 0 || SDL_ThreadID() != threadID)
+        return 0;
+    nestedTimes.push_back(0);
+    return MonotonicClock::getNanoseconds();
+}
+
+
+void
+FrameProfiler::endScope(size_t phase, Uint64 start)
+{
+    assert(!nestedTimes.empty());
+    Uint64 duration = MonotonicClock::getNanoseconds() - start;
+    Uint64 selfTime = duration - min(duration, nestedTimes.back());
+    nestedTimes.pop_back();
+    if (!nestedTimes.empty())
+        nestedTimes.back() += duration;
+    addTime(phase, selfTime);
+}
+
+
+Uint64
+FrameProfiler::getFrameTime(size_t age) const
+{
+    assert(age < numFrames);
+    return frameHistory[(nextFrame + HISTORY_SIZE - 1 - age) % HISTORY_SIZE];
+}
+
+
+Uint64
+FrameProfiler::getPhaseTime(size_t phase, size_t age) const
+{
+    assert(phase < phases.size());
+    assert(age < numFrames);
+    return phases[phase].history[(nextFrame + HISTORY_SIZE - 1 - age) % HISTORY_SIZE];
+}
+
+
+/*static*/
+Uint64
+FrameProfiler::getPercentile(const Uint64 *history, size_t n, double p)
+{
+    if (n == 0)
+        return 0;
+    Uint64 sorted[HISTORY_SIZE];
+    copy(history, history + n, sorted);
+    size_t k = size_t(p / 100 * (n - 1) + 0.5);
+    k = min(k, n - 1);
+    nth_element(sorted, sorted + k, sorted + n);
+    return sorted[k];
+}
+
+
+Uint64
+FrameProfiler::getFramePercentile(double p) const
+{
+    // While the history is not full, its frames are at the beginning.
+    return getPercentile(frameHistory, numFrames, p);
+}
+
+
+Uint64
+FrameProfiler::getPhasePercentile(size_t phase, double p) const
+{
+    assert(phase < phases.size());
+    return getPercentile(phases[phase].history, numFrames, p);
+}
+
+
+void
+FrameProfiler::clearHistory()
+{
+    nextFrame = 0;
+    numFrames = 0;
+}
@@ -0,0 +1,230 @@
+/*  $Id$
+    FrameProfiler.h - Per-frame timing of the phases of the main loop.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_FrameProfiler
+#define _H_FrameProfiler
+
+#include <flatzebra/MonotonicClock.h>
+
+#include <SDL_types.h>
+
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class FrameProfiler
+/*  Measures the time spent in each phase of every frame, and keeps
+    the totals of the most recent frames to compute statistics.
+
+    GameEngine registers the built-in phases below and times them.
+    A game can register its own phases and time them with ProfileScope.
+    A phase can be timed several times per frame: the durations are
+    added up.
+    A phase is charged its self time only: the time spent in scopes
+    nested inside it (e.g., the blits done by tick()) is charged to
+    the nested phases, so the phases of a frame add up to at most
+    the duration of the frame.
+
+    When the profiler is disabled (the default), a ProfileScope only
+    costs a test of a boolean.
+    Only the thread that called beginFrame() is measured: timings
+    made on other threads are ignored.
+*/
+{
+public:
+
+    enum BuiltInPhase
+    {
+        EVENTS,   // SDL event processing
+        TICK,     // tick()
+        RENDER,   // render(), for runFixedStep()
+        BLIT,     // copyPixmap() and copySpritePixmap()
+        TEXT,     // writeString() and its variants
+        PRESENT,  // presentScreen(), i.e., SDL_Flip() or SDL_UpdateRects()
+        WAIT,     // sleeping until the next frame
+        NUM_BUILT_IN_PHASES
+    };
+
+    enum { HISTORY_SIZE = 128 };  // number of frames kept
+
+    FrameProfiler();
+
+    void setEnabled(bool enable);
+    bool isEnabled() const;
+
+    size_t registerPhase(const char *name);
+    /*  Adds a phase and returns its number, to be passed to ProfileScope.
+        'name' must remain valid as long as this object.
+        If a phase with this name already exists, its number is returned.
+    */
+
+    size_t getNumPhases() const;
+    const char *getPhaseName(size_t phase) const;
+
+    void beginFrame();
+    void endFrame();
+    /*  Delimit a frame. endFrame() records the total of each phase
+        for that frame, and the duration of the whole frame.
+        Do nothing when disabled.
+    */
+
+    void addTime(size_t phase, Uint64 nanoseconds);
+    /*  Adds a duration to the given phase for the current frame.
+        This duration is not subtracted from the enclosing scope, if any.
+    */
+
+    Uint64 beginScope();
+    void endScope(size_t phase, Uint64 start);
+    /*  Called by ProfileScope.
+        beginScope() returns the current time, or zero if the scope
+        is not measured (no frame begun, or not the frame's thread).
+        endScope() charges the self time of the scope that began at
+        'start' to 'phase', and its whole duration to the scope that
+        encloses it.
+    */
+
+    size_t getNumFrames() const;
+    /*  Number of frames in the history (at most HISTORY_SIZE).
+    */
+
+    Uint64 getFrameTime(size_t age) const;
+    Uint64 getPhaseTime(size_t phase, size_t age) const;
+    /*  Duration of the whole frame, or of one of its phases, in
+        nanoseconds, for the frame that ended 'age' frames before
+        the most recent one (0 for the most recent).
+        'age' must be less than getNumFrames().
+    */
+
+    Uint64 getFramePercentile(double p) const;
+    Uint64 getPhasePercentile(size_t phase, double p) const;
+    /*  Returns the given percentile (e.g., 50 or 99) of the durations
+        in the history, or zero if the history is empty.
+    */
+
+    void clearHistory();
+
+private:
+
+    struct Phase
+    {
+        const char *name;
+        Uint64 current;  // total for the current frame
+        Uint64 history[HISTORY_SIZE];
+    };
+
+    static Uint64 getPercentile(const Uint64 *history, size_t n, double p);
+
+    bool enabled;
+    Uint32 threadID;  // thread that called beginFrame()
+    std::vector<Phase> phases;
+    std::vector<Uint64> nestedTimes;  // time of the scopes nested in each open scope
+    Uint64 frameStart;
+    Uint64 frameHistory[HISTORY_SIZE];
+    size_t nextFrame;  // index in histories of the next frame to record
+    size_t numFrames;
+};
+
+
+class ProfileScope
+/*  Adds the time spent between the construction and the destruction
+    of this object to a phase of a FrameProfiler, if it is enabled.
+    Example:
+        {
+            ProfileScope scope(profiler, aiPhase);
+            updateEnemies();
+        }
+*/
+{
+public:
+
+    ProfileScope(FrameProfiler &profiler, size_t phase);
+    ~ProfileScope();
+
+private:
+
+    FrameProfiler &profiler;
+    size_t phase;
+    Uint64 start;  // zero if the profiler was disabled
+
+    /*  Forbidden operations:
+    */
+    ProfileScope(const ProfileScope &);
+    ProfileScope &operator = (const ProfileScope &);
+};
+
+
+inline
+bool
+FrameProfiler::isEnabled() const
+{
+    return enabled;
+}
+
+
+inline
+size_t
+FrameProfiler::getNumPhases() const
+{
+    return phases.size();
+}
+
+
+inline
+const char *
+FrameProfiler::getPhaseName(size_t phase) const
+{
+    return phases[phase].name;
+}
+
+
+inline
+size_t
+FrameProfiler::getNumFrames() const
+{
+    return numFrames;
+}
+
+
+inline
+ProfileScope::ProfileScope(FrameProfiler &p, size_t ph)
+  : profiler(p),
+    phase(ph),
+    start(p.isEnabled() ? p.beginScope() : 0)
+{
+}
+
+
+inline
+ProfileScope::~ProfileScope()
+{
+    if (start != 0)
+        profiler.endScope(phase, start);
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_FrameProfiler */
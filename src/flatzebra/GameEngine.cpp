@@ -22,9 +22,13 @@
 
 #include <flatzebra/GameEngine.h>
 
+#include <flatzebra/MonotonicClock.h>
+
 #include "font_13x7.xpm"
 
+#include <algorithm>
 #include <assert.h>
+#include <stdio.h>
 
 using namespace std;
 using namespace flatzebra;
@@ -33,18 +37,63 @@ using namespace flatzebra;
 GameEngine::GameEngine(Couple screenSizeInPixels,
                         const string &wmCaption,
                         bool fullScreen,
-                        bool _processActiveEvent) throw(string)
+                        bool _processActiveEvent,
+                        bool _headless) throw(string)
   : theScreenSizeInPixels(screenSizeInPixels),
     theSDLScreen(NULL),
     fixedWidthFontPixmap(NULL),
     theDepth(0),
     usingFullScreen(false),
-    processActiveEvent(_processActiveEvent)
+    processActiveEvent(_processActiveEvent),
+    headless(_headless),
+    frameDumpPrefix(),
+    numDumpedFrames(0),
+    fixedWidthFontArray(),
+    nextWuRamp(0),
+    thePacer(),
+    theTelemetry(),
+    telemetryExitFileName(),
+    telemetryExitFormat(TelemetryRecorder::CHROME_TRACE_JSON),
+    numScreenBlits(0),
+    numBlitsDrawn(0),
+    numBlitsCulled(0),
+    theJobSystem(JobSystem::getNumProcessors() - 1),
+    theProfiler(),
+    showingProfilerOverlay(false),
+    nativeBlits(true),
+    theDrawList(),
+    usingDirtyRects(false),
+    dirtyRects(),
+    stringCacheList(),
+    stringCacheIndex(),
+    stringCacheSize(0),
+    stringCacheBudget(DEFAULT_STRING_CACHE_BUDGET),
+    bypassingStringCache(false),
+    theViewport(NULL),
+    inputLog(NULL),
+    tickCount(0),
+    threadedMode(false),
+    threadedMillisecondsPerFrame(0),
+    simulationThreadID(0),
+    drawBuffers(),
+    simBuffer(NULL),
+    presentBuffer(NULL),
+    recordedScreenClip(),
+    threadMutex(NULL),
+    threadCond(NULL),
+    readyBuffer(NULL),
+    readyBufferFull(false),
+    pendingKeys(),
+    quitRequested(false),
+    pauseRequested(false),
+    simulationPaused(false),
+    simulationFinished(false)
 {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
+    if (SDL_Init(headless ? SDL_INIT_TIMER : SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
         throw string(SDL_GetError());
 
-    SDL_WM_SetCaption(wmCaption.c_str(), wmCaption.c_str());
+    if (!headless)
+        SDL_WM_SetCaption(wmCaption.c_str(), wmCaption.c_str());
 
     string errorMsg = setVideoMode(screenSizeInPixels, fullScreen);
     if (!errorMsg.empty())
@@ -70,96 +119,1041 @@ GameEngine::GameEngine(Couple screenSizeInPixels,
             default:
                 SDL_EventState((Uint8) i, SDL_IGNORE);
         }
-    }
+    }
+
+    // Prepare a fixed width font pixmap:
+    try
+    {
+        loadPixmap(font_13x7_xpm, fixedWidthFontArray, 0);
+        fixedWidthFontPixmap = fixedWidthFontArray.getImage(0);
+        assert(fixedWidthFontPixmap != NULL);
+    }
+    catch (PixmapLoadError)
+    {
+        throw string("Could not load fixed width font pixmap");
+    }
+
+
+    initWuLineAlgorithm();
+}
+
+
+GameEngine::~GameEngine()
+{
+    if (!telemetryExitFileName.empty())
+    {
+        (void) theTelemetry.waitForFlush();
+        if (theTelemetry.flush(telemetryExitFileName, telemetryExitFormat))
+            (void) theTelemetry.waitForFlush();
+    }
+
+    evictStrings(0);  // before SDL_Quit()
+    fixedWidthFontArray.freeImages();
+    if (headless)
+        PixmapArray::setDisplaySurface(NULL);
+    SDL_FreeSurface(theSDLScreen);
+    SDL_Quit();
+}
+
+
+string
+GameEngine::setVideoMode(Couple screenSizeInPixels, bool fullScreen)
+{
+    Uint32 flags = SDL_HWSURFACE | SDL_ANYFORMAT;
+    if (fullScreen)
+        flags |= SDL_FULLSCREEN;
+
+    // Remember the current pixel format, if any, to detect a change.
+    Uint8 oldBitsPerPixel = 0;
+    Uint32 oldRmask = 0, oldGmask = 0, oldBmask = 0;
+    if (theSDLScreen != NULL)
+    {
+        oldBitsPerPixel = theSDLScreen->format->BitsPerPixel;
+        oldRmask = theSDLScreen->format->Rmask;
+        oldGmask = theSDLScreen->format->Gmask;
+        oldBmask = theSDLScreen->format->Bmask;
+    }
+
+    if (headless)
+    {
+        SDL_Surface *surface = SDL_CreateRGBSurface(
+                            SDL_SWSURFACE,
+                            screenSizeInPixels.x, screenSizeInPixels.y, 32,
+                            0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+        if (surface == NULL)
+            return string(SDL_GetError());
+        SDL_FreeSurface(theSDLScreen);
+        theSDLScreen = surface;
+        theDepth = 32;
+        PixmapArray::setDisplaySurface(theSDLScreen);
+    }
+    else
+    {
+        theDepth = SDL_VideoModeOK(
+                            screenSizeInPixels.x, screenSizeInPixels.y,
+                            32, flags);
+        if (theDepth <= 0)
+            return string("video mode not available");
+
+        theSDLScreen = SDL_SetVideoMode(
+                                screenSizeInPixels.x, screenSizeInPixels.y,
+                            theDepth, flags);
+        if (theSDLScreen == NULL)
+            throw string(SDL_GetError());
+
+        // Hide the mouse pointer when in full-screen mode.
+        SDL_ShowCursor(fullScreen ? SDL_DISABLE : SDL_ENABLE);
+    }
+
+    usingFullScreen = fullScreen;
+
+    theWriters = getPixelWriters(theSDLScreen->format->BytesPerPixel);
+
+    // The cached line colors were mapped for the previous screen.
+    for (size_t i = 0; i < NUM_WU_RAMPS; i++)
+        wuRamps[i].format = NULL;
+
+    // Pixmaps converted for the previous format would need to be
+    // converted again at every blit.
+    const SDL_PixelFormat *fmt = theSDLScreen->format;
+    if (oldBitsPerPixel != 0
+            && (fmt->BitsPerPixel != oldBitsPerPixel
+                || fmt->Rmask != oldRmask
+                || fmt->Gmask != oldGmask
+                || fmt->Bmask != oldBmask))
+    {
+        evictStrings(0);  // composited in the previous format
+        PixmapArray::convertAllToDisplayFormat();
+        if (fixedWidthFontArray.getNumImages() != 0)
+            fixedWidthFontPixmap = fixedWidthFontArray.getImage(0);
+    }
+
+    // The new screen has the default clipping rectangle.
+    setViewport(theViewport);
+
+    // The new screen has not been presented yet.
+    dirtyRects.clear();
+    markDirtyRect(0, 0, screenSizeInPixels.x, screenSizeInPixels.y);
+
+    return string();
+}
+
+
+void
+GameEngine::setFrameDump(const string &filePrefix)
+{
+    frameDumpPrefix = filePrefix;
+    numDumpedFrames = 0;
+}
+
+
+void
+GameEngine::setDirtyRectMode(bool enable)
+{
+    usingDirtyRects = enable;
+    dirtyRects.clear();
+    markDirtyRect(0, 0, theScreenSizeInPixels.x, theScreenSizeInPixels.y);
+}
+
+
+void
+GameEngine::markDirtyRect(int x, int y, int width, int height) const
+{
+    if (isRecordingDraws())
+    {
+        simBuffer->addDirtyRect(x, y, width, height);
+        return;
+    }
+    if (!usingDirtyRects)
+        return;
+
+    // Clip to the screen before converting to SDL's 16-bit fields.
+    if (x < 0)
+    {
+        width += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        height += y;
+        y = 0;
+    }
+    if (x + width > theScreenSizeInPixels.x)
+        width = theScreenSizeInPixels.x - x;
+    if (y + height > theScreenSizeInPixels.y)
+        height = theScreenSizeInPixels.y - y;
+    if (width <= 0 || height <= 0)
+        return;
+
+    SDL_Rect r = { Sint16(x), Sint16(y), Uint16(width), Uint16(height) };
+    addDirtyRect(r);
+}
+
+
+void
+GameEngine::addDirtyRect(SDL_Rect r) const
+{
+    if (r.w == 0 || r.h == 0)
+        return;
+
+    /*  Merge 'r' with every recorded rectangle that it overlaps,
+        until it overlaps none of them. The union may then overlap
+        rectangles that were already checked, hence the restart.
+    */
+    for (size_t i = 0; i < dirtyRects.size(); )
+    {
+        const SDL_Rect &d = dirtyRects[i];
+        if (r.x + r.w <= d.x || d.x + d.w <= r.x
+                || r.y + r.h <= d.y || d.y + d.h <= r.y)
+        {
+            i++;
+            continue;
+        }
+
+        int left   = (r.x < d.x ? r.x : d.x);
+        int top    = (r.y < d.y ? r.y : d.y);
+        int right  = (r.x + r.w > d.x + d.w ? r.x + r.w : d.x + d.w);
+        int bottom = (r.y + r.h > d.y + d.h ? r.y + r.h : d.y + d.h);
+        r.x = Sint16(left);
+        r.y = Sint16(top);
+        r.w = Uint16(right - left);
+        r.h = Uint16(bottom - top);
+
+        dirtyRects[i] = dirtyRects.back();
+        dirtyRects.pop_back();
+        i = 0;
+    }
+
+    if (dirtyRects.size() >= MAX_DIRTY_RECTS)
+    {
+        // Too fragmented: present the whole screen.
+        r.x = r.y = 0;
+        r.w = Uint16(theScreenSizeInPixels.x);
+        r.h = Uint16(theScreenSizeInPixels.y);
+        dirtyRects.clear();
+    }
+
+    dirtyRects.push_back(r);
+}
+
+
+void
+GameEngine::presentScreen()
+{
+    ProfileScope scope(theProfiler, FrameProfiler::PRESENT);
+    TelemetryScope telemetryScope(theTelemetry, "present");
+
+    if (headless)
+    {
+        dirtyRects.clear();
+        if (!frameDumpPrefix.empty())
+        {
+            char number[16];
+            snprintf(number, sizeof(number), "%06lu", numDumpedFrames++);
+            SDL_SaveBMP(theSDLScreen, (frameDumpPrefix + number + ".bmp").c_str());
+        }
+        return;
+    }
+
+    if (!usingDirtyRects)
+    {
+        SDL_Flip(theSDLScreen);
+        return;
+    }
+
+    if (!dirtyRects.empty())
+    {
+        SDL_UpdateRects(theSDLScreen, int(dirtyRects.size()), &dirtyRects[0]);
+        dirtyRects.clear();
+    }
+}
+
+
+void GameEngine::run(int millisecondsPerFrame)
+{
+    thePacer.setFramePeriod(Uint64(millisecondsPerFrame) * 1000000);
+
+    for (;;)
+    {
+        beginFrame();
+
+        if (!processEvents())
+            return;
+
+        {
+            ProfileScope scope(theProfiler, FrameProfiler::TICK);
+            if (!callTick())
+                return;
+        }
+
+        flushDrawList();
+
+        if (showingProfilerOverlay)
+            drawProfilerOverlay();
+
+        presentScreen();
+
+        // Pause for the rest of the current animation frame.
+        {
+            ProfileScope scope(theProfiler, FrameProfiler::WAIT);
+            thePacer.waitForNextFrame();
+        }
+
+        endFrame();
+    }
+}
+
+
+void
+GameEngine::runFixedStep(int ticksPerSecond,
+                         int maxFramesPerSecond,
+                         int maxTicksPerFrame)
+{
+    assert(ticksPerSecond > 0);
+    assert(maxTicksPerFrame > 0);
+
+    const Uint64 tickPeriod = 1000000000 / Uint64(ticksPerSecond);
+    thePacer.setFramePeriod(maxFramesPerSecond > 0
+                                ? 1000000000 / Uint64(maxFramesPerSecond)
+                                : 0);
+    Uint64 accumulator = tickPeriod;  // so that the first frame has a tick
+    Uint64 previousTime = MonotonicClock::getNanoseconds();
+
+    for (;;)
+    {
+        beginFrame();
+
+        if (!processEvents())
+            return;
+
+        Uint64 now = MonotonicClock::getNanoseconds();
+        accumulator += now - previousTime;
+        previousTime = now;
+
+        for (int numTicks = 0; accumulator >= tickPeriod; numTicks++)
+        {
+            if (numTicks == maxTicksPerFrame)
+            {
+                accumulator %= tickPeriod;  // drop the ticks that are late
+                break;
+            }
+            ProfileScope scope(theProfiler, FrameProfiler::TICK);
+            if (!callTick())
+                return;
+            accumulator -= tickPeriod;
+        }
+
+        {
+            ProfileScope scope(theProfiler, FrameProfiler::RENDER);
+            render(double(accumulator) / double(tickPeriod));  // virtual function
+        }
+
+        flushDrawList();
+
+        if (showingProfilerOverlay)
+            drawProfilerOverlay();
+
+        presentScreen();
+
+        // Pause for the rest of the current display frame.
+        {
+            ProfileScope scope(theProfiler, FrameProfiler::WAIT);
+            thePacer.waitForNextFrame();
+        }
+
+        endFrame();
+    }
+}
+
+
+/*virtual*/
+void
+GameEngine::render(double /*alpha*/)
+{
+}
+
+
+void
+GameEngine::setViewport(const Viewport *viewport)
+{
+    theViewport = viewport;
+
+    SDL_Rect clip = { 0, 0, Uint16(theSDLScreen->w), Uint16(theSDLScreen->h) };
+    if (viewport != NULL)
+        clip = viewport->getScreenRect();
+    if (isRecordingDraws())
+    {
+        simBuffer->addClipRect(clip.x, clip.y, clip.w, clip.h);
+        recordedScreenClip = clip;
+    }
+    else
+        SDL_SetClipRect(theSDLScreen, &clip);
+}
+
+
+void
+GameEngine::copyBackground(ScrollingBackground &bg)
+{
+    Couple origin = (theViewport != NULL ? theViewport->getOrigin() : Couple());
+    if (bg.scrollTo(origin))
+        copyPixmap(bg.getSurface(), origin);
+}
+
+
+// Division rounded toward minus infinity; 'b' must be positive.
+static int
+floorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+
+void
+GameEngine::copyTileMap(TileMap &map, Couple pos)
+{
+    const SDL_Rect &clip = getCullRect(theSDLScreen);
+    Couple corner = pos + getViewOffset(theSDLScreen);  // on the screen
+    Couple chunkSize = map.getChunkSizeInPixels();
+    Couple numChunks = map.getNumChunks();
+
+    int firstCol = max(0, floorDiv(clip.x - corner.x, chunkSize.x));
+    int firstRow = max(0, floorDiv(clip.y - corner.y, chunkSize.y));
+    int lastCol = min(numChunks.x - 1,
+                      floorDiv(clip.x + clip.w - 1 - corner.x, chunkSize.x));
+    int lastRow = min(numChunks.y - 1,
+                      floorDiv(clip.y + clip.h - 1 - corner.y, chunkSize.y));
+
+    for (int row = firstRow; row <= lastRow; row++)
+        for (int col = firstCol; col <= lastCol; col++)
+        {
+            SDL_Surface *chunk = map.getChunkSurface(col, row);
+            if (chunk != NULL)
+                copyPixmap(chunk, pos + Couple(col * chunkSize.x,
+                                               row * chunkSize.y));
+        }
+}
+
+
+void
+GameEngine::resetBlitCounters()
+{
+    numBlitsDrawn = 0;
+    numBlitsCulled = 0;
+}
+
+
+static bool
+sameRect(const SDL_Rect &a, const SDL_Rect &b)
+{
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+
+void
+GameEngine::flushDrawList()
+{
+    if (theDrawList.empty())
+        return;
+
+    ProfileScope scope(theProfiler, FrameProfiler::BLIT);
+    theDrawList.sort();
+
+    // Each blit is clipped to the rectangle that was in effect when it
+    // was submitted; the current one is restored afterwards.
+    if (isRecordingDraws())
+    {
+        SDL_Rect clip = recordedScreenClip;
+        for (size_t i = 0; i < theDrawList.size(); i++)
+        {
+            const DrawList::Entry &e = theDrawList[i];
+            if (!sameRect(e.clip, clip))
+            {
+                clip = e.clip;
+                simBuffer->addClipRect(clip.x, clip.y, clip.w, clip.h);
+            }
+            simBuffer->addBlit(e.image, &e.srcrect, e.x, e.y);
+        }
+        if (!sameRect(clip, recordedScreenClip))
+        {
+            const SDL_Rect &r = recordedScreenClip;
+            simBuffer->addClipRect(r.x, r.y, r.w, r.h);
+        }
+        theDrawList.clear();
+        return;
+    }
+
+    const SDL_Rect screenClip = theSDLScreen->clip_rect;
+    SDL_Surface *checkedImage = NULL;  // source of the previous native blit
+    bool native = false;
+    for (size_t i = 0; i < theDrawList.size(); i++)
+    {
+        const DrawList::Entry &e = theDrawList[i];
+        if (!sameRect(e.clip, theSDLScreen->clip_rect))
+            SDL_SetClipRect(theSDLScreen, &e.clip);
+        if (e.image != checkedImage)
+        {
+            checkedImage = e.image;
+            native = nativeBlits && ColorKeyBlitter::canBlit(e.image, theSDLScreen);
+        }
+
+        SDL_Rect srcrect = e.srcrect;
+        SDL_Rect dstrect = { Sint16(e.x), Sint16(e.y), 0, 0 };
+        if (native && srcrect.w <= ColorKeyBlitter::MAX_SPRITE_WIDTH)
+            ColorKeyBlitter::blitUnchecked(e.image, &srcrect, theSDLScreen, &dstrect);
+        else
+        {
+            SDL_BlitSurface(e.image, &srcrect, theSDLScreen, &dstrect);
+            checkedImage = NULL;  // SDL may have RLE-encoded the image
+        }
+
+        numScreenBlits++;
+        if (usingDirtyRects)
+            addDirtyRect(dstrect);
+    }
+    if (!sameRect(screenClip, theSDLScreen->clip_rect))
+        SDL_SetClipRect(theSDLScreen, &screenClip);
+    theDrawList.clear();
+}
+
+
+bool
+GameEngine::processEvents()
+{
+    ProfileScope scope(theProfiler, FrameProfiler::EVENTS);
+
+    SDL_Event event;
+    while (SDL_PollEvent(&event))
+    {
+        if (event.type == SDL_KEYDOWN)
+            dispatchKey(event.key.keysym.sym, true);
+        else if (event.type == SDL_KEYUP)
+            dispatchKey(event.key.keysym.sym, false);
+        else if (processActiveEvent && event.type == SDL_ACTIVEEVENT
+                                    && !isReplayingInput())
+        {
+            // If app is now inactive (iconified or lost focus),
+            // go wait for reactivation, i.e., stop calling tick().
+            // This avoids using the CPU while the app is not active.
+            //
+            if (event.active.gain == 0 && !waitForReactivation())
+            {
+                recordInputEnd();
+                return false;  // wait ended with quit or with wait error
+            }
+        }
+        else if (event.type == SDL_QUIT)
+        {
+            recordInputEnd();
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void
+GameEngine::setInputLog(InputLog *log)
+{
+    inputLog = log;
+    tickCount = 0;
+    if (inputLog != NULL)
+        inputLog->setTick(tickCount);
+}
+
+
+bool
+GameEngine::callTick()
+{
+    if (!injectLoggedInput())
+        return false;
+
+    bool keepGoing;
+    {
+        TelemetryScope telemetryScope(theTelemetry, "tick");
+        keepGoing = tick();  // virtual function
+    }
+
+    // Events received from now on precede the next tick.
+    tickCount++;
+    if (inputLog != NULL)
+        inputLog->setTick(tickCount);
+
+    if (!keepGoing)
+        recordInputEnd();
+    return keepGoing;
+}
+
+
+bool
+GameEngine::injectLoggedInput()
+{
+    if (!isReplayingInput())
+        return true;
+
+    InputLog::Event event;
+    while (inputLog->getNextEvent(event))
+    {
+        switch (event.type)
+        {
+            case InputLog::KEY:
+                processKey(event.key, event.pressed);  // virtual function
+                break;
+            case InputLog::ACTIVATION:
+                processActivation(event.pressed);  // virtual function
+                break;
+            case InputLog::END:
+                return false;
+            case InputLog::JOYSTICK:
+                break;  // not returned by getNextEvent()
+        }
+    }
+    return true;
+}
+
+
+void
+GameEngine::dispatchKey(SDLKey key, bool pressed)
+{
+    if (inputLog != NULL)
+    {
+        if (inputLog->getMode() == InputLog::REPLAYING)
+            return;  // only the logged keys are seen by the game
+        inputLog->recordKey(key, pressed);
+    }
+    processKey(key, pressed);  // virtual function
+}
+
+
+void
+GameEngine::dispatchActivation(bool appActive)
+{
+    if (inputLog != NULL)
+        inputLog->recordActivation(appActive);
+    processActivation(appActive);  // virtual function
+}
+
+
+void
+GameEngine::recordInputEnd()
+{
+    if (inputLog != NULL)
+        inputLog->recordEnd();
+}
+
+
+bool
+GameEngine::isReplayingInput() const
+{
+    return inputLog != NULL && inputLog->getMode() == InputLog::REPLAYING;
+}
+
+
+void
+GameEngine::beginFrame()
+{
+    theProfiler.beginFrame();
+    theTelemetry.recordBegin("frame");
+    numScreenBlits = 0;
+}
+
+
+void
+GameEngine::endFrame()
+{
+    theTelemetry.recordCounter("blits", Sint64(numScreenBlits));
+    theTelemetry.recordEnd("frame");
+    theProfiler.endFrame();
+}
+
+
+void
+GameEngine::setTelemetryExitFile(const string &fileName,
+                                 TelemetryRecorder::Format format)
+{
+    telemetryExitFileName = fileName;
+    telemetryExitFormat = format;
+}
+
+
+void
+GameEngine::setProfilerOverlay(bool show)
+{
+    showingProfilerOverlay = show;
+    if (show)
+        theProfiler.setEnabled(true);
+}
+
+
+void
+GameEngine::drawProfilerOverlay()
+{
+    const int graphHeight = 32;
+    const Uint64 nsPerPixel = 1000000;  // one pixel per millisecond
+    const Couple fontDim = getFontDimensions();
+    const int lineWidth = 26;  // characters per line of text
+    const int width = max(int(FrameProfiler::HISTORY_SIZE), lineWidth * fontDim.x);
+    const Couple pos(2, 2);
+
+    // The overlay is in screen coordinates, over any viewport.
+    const Viewport *viewport = theViewport;
+    if (!threadedMode)
+        theViewport = NULL;
+    SDL_Rect clip = theSDLScreen->clip_rect;
+    SDL_SetClipRect(theSDLScreen, NULL);
+
+    // Lines of text: the frame, then the phases that took time.
+    vector<size_t> shownPhases;
+    for (size_t i = 0; i < theProfiler.getNumPhases(); i++)
+        if (theProfiler.getPhasePercentile(i, 99) != 0)
+            shownPhases.push_back(i);
+    int height = graphHeight + fontDim.y * int(2 + shownPhases.size());
+
+    SDL_PixelFormat *fmt = theSDLScreen->format;
+    fillRect(pos.x, pos.y, width, height, SDL_MapRGB(fmt, 0, 0, 0));
+
+    // Graph of the frame times, the most recent at the right.
+    Uint32 barColor = SDL_MapRGB(fmt, 0, 255, 0);
+    Uint32 slowBarColor = SDL_MapRGB(fmt, 255, 64, 64);
+    Uint64 framePeriod = thePacer.getFramePeriod();
+    int x = pos.x + int(FrameProfiler::HISTORY_SIZE);
+    for (size_t age = 0; age < theProfiler.getNumFrames(); age++)
+    {
+        Uint64 t = theProfiler.getFrameTime(age);
+        int h = int(min(t / nsPerPixel, Uint64(graphHeight)));
+        bool slow = (framePeriod != 0 && t > framePeriod + framePeriod / 10);
+        fillRect(--x, pos.y + graphHeight - h, 1, h, slow ? slowBarColor : barColor);
+    }
+
+    // Percentiles in milliseconds. They change every frame, so they
+    // would only evict the game's strings from the string cache.
+    bypassingStringCache = true;
+    char line[64];
+    int y = pos.y + graphHeight;
+    snprintf(line, sizeof(line), "%-8s %7s %7s", "ms", "p50", "p99");
+    writeString(line, Couple(pos.x, y));
+    y += fontDim.y;
+    snprintf(line, sizeof(line), "%-8s %7.2f %7.2f", "frame",
+             theProfiler.getFramePercentile(50) / 1e6,
+             theProfiler.getFramePercentile(99) / 1e6);
+    writeString(line, Couple(pos.x, y));
+    for (size_t i = 0; i < shownPhases.size(); i++)
+    {
+        size_t phase = shownPhases[i];
+        y += fontDim.y;
+        snprintf(line, sizeof(line), "%-8.8s %7.2f %7.2f",
+                 theProfiler.getPhaseName(phase),
+                 theProfiler.getPhasePercentile(phase, 50) / 1e6,
+                 theProfiler.getPhasePercentile(phase, 99) / 1e6);
+        writeString(line, Couple(pos.x, y));
+    }
+    bypassingStringCache = false;
+
+    SDL_SetClipRect(theSDLScreen, &clip);
+    if (!threadedMode)
+        theViewport = viewport;
+}
+
+
+void
+GameEngine::runThreaded(int millisecondsPerFrame)
+{
+    threadMutex = SDL_CreateMutex();
+    threadCond = SDL_CreateCond();
+    for (size_t i = 0; i < 3; i++)
+        drawBuffers[i].clear();
+    simBuffer = &drawBuffers[0];
+    readyBuffer = &drawBuffers[1];
+    presentBuffer = &drawBuffers[2];
+    recordedScreenClip = theSDLScreen->clip_rect;
+    readyBufferFull = false;
+    pendingKeys.clear();
+    quitRequested = false;
+    pauseRequested = false;
+    simulationPaused = false;
+    simulationFinished = false;
+    threadedMillisecondsPerFrame = millisecondsPerFrame;
+
+    SDL_Thread *thread = NULL;
+    if (threadMutex != NULL && threadCond != NULL)
+    {
+        threadedMode = true;
+        thread = SDL_CreateThread(simulationThreadMain, this);
+    }
+    if (thread == NULL)
+    {
+        threadedMode = false;
+        if (threadCond != NULL)
+            SDL_DestroyCond(threadCond);
+        if (threadMutex != NULL)
+            SDL_DestroyMutex(threadMutex);
+        threadCond = NULL;
+        threadMutex = NULL;
+        run(millisecondsPerFrame);
+        return;
+    }
+
+    /*  Presentation loop: forward the events to the simulation thread,
+        and perform and present the drawing that it publishes.
+        SDL 1.2 requires the video and event functions to be called
+        from this thread.
+    */
+    beginFrame();  // a frame ends with each presentation
+    SDL_LockMutex(threadMutex);
+    while (!simulationFinished || readyBufferFull)
+    {
+        SDL_UnlockMutex(threadMutex);
+
+        SDL_Event event;
+        {
+            ProfileScope scope(theProfiler, FrameProfiler::EVENTS);
+            while (SDL_PollEvent(&event))
+            {
+                SDL_LockMutex(threadMutex);
+                if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
+                    pendingKeys.push_back(make_pair(event.key.keysym.sym,
+                                                    event.type == SDL_KEYDOWN));
+                else if (processActiveEvent && event.type == SDL_ACTIVEEVENT
+                                            && !isReplayingInput())
+                {
+                    if (event.active.gain == 0)
+                        pauseRequested = true;
+                }
+                else if (event.type == SDL_QUIT)
+                    quitRequested = true;
+                SDL_UnlockMutex(threadMutex);
+            }
+        }
+
+        SDL_LockMutex(threadMutex);
+        if (readyBufferFull)
+        {
+            swap(readyBuffer, presentBuffer);
+            readyBufferFull = false;
+            SDL_UnlockMutex(threadMutex);
+
+            playDrawCommands(*presentBuffer);
+            presentBuffer->clear();
+            if (showingProfilerOverlay)
+                drawProfilerOverlay();
+            presentScreen();
+            endFrame();
+            beginFrame();
+
+            SDL_LockMutex(threadMutex);
+        }
+        else if (simulationPaused && pauseRequested)
+        {
+            /*  The simulation thread has called processActivation(false)
+                and its drawing has been presented. Sleep on the SDL event
+                loop until reactivation.
+            */
+            SDL_UnlockMutex(threadMutex);
+            bool reactivated = false;
+            while (SDL_WaitEvent(&event))
+            {
+                if (event.type == SDL_QUIT)
+                    break;
+                if (event.type == SDL_ACTIVEEVENT && event.active.gain != 0)
+                {
+                    reactivated = true;
+                    break;
+                }
+            }
+            SDL_LockMutex(threadMutex);
+            if (!reactivated)
+                quitRequested = true;
+            pauseRequested = false;
+            SDL_CondBroadcast(threadCond);
+        }
+        else if (!simulationFinished)
+        {
+            ProfileScope scope(theProfiler, FrameProfiler::WAIT);
+            SDL_CondWaitTimeout(threadCond, threadMutex, 10);  // keep polling events
+        }
+    }
+    SDL_UnlockMutex(threadMutex);
+
+    SDL_WaitThread(thread, NULL);
+
+    threadedMode = false;
+    SDL_DestroyCond(threadCond);
+    SDL_DestroyMutex(threadMutex);
+    threadCond = NULL;
+    threadMutex = NULL;
+}
+
+
+/*static*/
+int
+GameEngine::simulationThreadMain(void *engine)
+{
+    static_cast<GameEngine *>(engine)->simulationLoop();
+    return 0;
+}
+
+
+void
+GameEngine::simulationLoop()
+{
+    simulationThreadID = SDL_ThreadID();
+
+    thePacer.setFramePeriod(Uint64(threadedMillisecondsPerFrame) * 1000000);
+
+    vector<pair<SDLKey, bool> > keys;
+    for (;;)
+    {
+        SDL_LockMutex(threadMutex);
+        keys.swap(pendingKeys);
+        bool quit = quitRequested;
+        bool pause = pauseRequested;
+        SDL_UnlockMutex(threadMutex);
+
+        for (vector<pair<SDLKey, bool> >::const_iterator it = keys.begin();
+                                                        it != keys.end(); ++it)
+            dispatchKey(it->first, it->second);
+        keys.clear();
+
+        if (quit)
+        {
+            recordInputEnd();
+            break;
+        }
+
+        if (pause)
+        {
+            dispatchActivation(false);
+            publishDrawCommands();
+
+            SDL_LockMutex(threadMutex);
+            simulationPaused = true;
+            SDL_CondBroadcast(threadCond);
+            while (pauseRequested)
+                SDL_CondWait(threadCond, threadMutex);
+            simulationPaused = false;
+            quit = quitRequested;
+            SDL_UnlockMutex(threadMutex);
+
+            dispatchActivation(true);
+            if (quit)
+            {
+                recordInputEnd();
+                break;
+            }
+            thePacer.restart();
+            continue;
+        }
 
-    // Prepare a fixed width font pixmap:
-    try
-    {
-        Couple dummy;
-        loadPixmap(font_13x7_xpm, fixedWidthFontPixmap, dummy);
-        assert(fixedWidthFontPixmap != NULL);
-    }
-    catch (PixmapLoadError)
-    {
-        throw string("Could not load fixed width font pixmap");
+        if (!callTick())
+            break;
+
+        flushDrawList();
+        publishDrawCommands();
+
+        // Pause for the rest of the current animation frame.
+        thePacer.waitForNextFrame();
     }
 
+    publishDrawCommands();
 
-    initWuLineAlgorithm();
+    SDL_LockMutex(threadMutex);
+    simulationFinished = true;
+    SDL_CondBroadcast(threadCond);
+    SDL_UnlockMutex(threadMutex);
 }
 
 
-GameEngine::~GameEngine()
+void
+GameEngine::publishDrawCommands()
 {
-    SDL_FreeSurface(fixedWidthFontPixmap);
-    SDL_FreeSurface(theSDLScreen);
-    SDL_Quit();
+    SDL_LockMutex(threadMutex);
+    if (readyBufferFull)
+    {
+        // The previous frame has not been presented yet: keep its drawing.
+        readyBuffer->append(*simBuffer);
+        simBuffer->clear();
+    }
+    else
+    {
+        swap(simBuffer, readyBuffer);
+        readyBufferFull = true;
+    }
+    SDL_CondBroadcast(threadCond);
+    SDL_UnlockMutex(threadMutex);
 }
 
 
-string
-GameEngine::setVideoMode(Couple screenSizeInPixels, bool fullScreen)
+void
+GameEngine::playDrawCommands(const DrawCommandBuffer &buffer)
 {
-    Uint32 flags = SDL_HWSURFACE | SDL_ANYFORMAT;
-    if (fullScreen)
-        flags |= SDL_FULLSCREEN;
+    const int *ints = buffer.getInts();
+    const char *text = buffer.getText();
+    vector<Couple> points;
+    vector<Span> spans;
 
-    theDepth = SDL_VideoModeOK(
-                        screenSizeInPixels.x, screenSizeInPixels.y,
-                        32, flags);
-    if (theDepth <= 0)
-        return string("video mode not available");
+    for (size_t i = 0; i < buffer.size(); i++)
+    {
+        const DrawCommandBuffer::Command &c = buffer[i];
+        switch (c.type)
+        {
+            case DrawCommandBuffer::BLIT:
+            {
+                SDL_Rect srcrect = c.sourceRect;
+                SDL_Rect dstrect = { Sint16(c.x), Sint16(c.y), 0, 0 };
+                blitSurface(c.source, srcrect.w != 0 ? &srcrect : NULL,
+                            theSDLScreen, &dstrect);
+                numScreenBlits++;
+                if (usingDirtyRects)
+                    addDirtyRect(dstrect);
+                break;
+            }
 
-    theSDLScreen = SDL_SetVideoMode(
-                            screenSizeInPixels.x, screenSizeInPixels.y,
-                        theDepth, flags);
-    if (theSDLScreen == NULL)
-        throw string(SDL_GetError());
+            case DrawCommandBuffer::FILL_RECT:
+                fillRect(c.x, c.y, c.width, c.height, c.color);
+                break;
 
-    // Hide the mouse pointer when in full-screen mode.
-    SDL_ShowCursor(fullScreen ? SDL_DISABLE : SDL_ENABLE);
+            case DrawCommandBuffer::PIXELS:
+            case DrawCommandBuffer::LINES:
+                if (c.count == 0)
+                    break;
+                points.resize(c.count);
+                for (size_t j = 0; j < c.count; j++)
+                    points[j] = Couple(ints[c.first + 2 * j],
+                                       ints[c.first + 2 * j + 1]);
+                if (c.type == DrawCommandBuffer::PIXELS)
+                    drawPixels(&points[0], c.count, c.color);
+                else
+                    drawLines(&points[0], c.count, c.color);
+                break;
 
-    usingFullScreen = fullScreen;
-    return string();
-}
+            case DrawCommandBuffer::SPANS:
+                if (c.count == 0)
+                    break;
+                spans.resize(c.count);
+                for (size_t j = 0; j < c.count; j++)
+                {
+                    spans[j].x = ints[c.first + 3 * j];
+                    spans[j].y = ints[c.first + 3 * j + 1];
+                    spans[j].width = ints[c.first + 3 * j + 2];
+                }
+                drawSpans(&spans[0], c.count, c.color);
+                break;
 
+            case DrawCommandBuffer::TEXT:
+                writeString(text + c.first, Couple(c.x, c.y));
+                break;
 
-void GameEngine::run(int millisecondsPerFrame)
-{
-    for (;;)
-    {
-        Uint32 lastTime = SDL_GetTicks();
+            case DrawCommandBuffer::DIRTY_RECT:
+                markDirtyRect(c.x, c.y, c.width, c.height);
+                break;
 
-        SDL_Event event;
-        while (SDL_PollEvent(&event))
-        {
-            if (event.type == SDL_KEYDOWN)
-                processKey(event.key.keysym.sym, true);   // virtual function
-            else if (event.type == SDL_KEYUP)
-                processKey(event.key.keysym.sym, false);  // virtual function
-            else if (processActiveEvent && event.type == SDL_ACTIVEEVENT)
+            case DrawCommandBuffer::CLIP_RECT:
             {
-                // If app is now inactive (iconified or lost focus),
-                // go wait for reactivation, i.e., stop calling tick().
-                // This avoids using the CPU while the app is not active.
-                //
-                if (event.active.gain == 0 && !waitForReactivation())
-                    return;  // wait ended with quit or with wait error
+                SDL_Rect clip = { Sint16(c.x), Sint16(c.y),
+                                  Uint16(c.width), Uint16(c.height) };
+                SDL_SetClipRect(theSDLScreen, &clip);
+                break;
             }
-            else if (event.type == SDL_QUIT)
-                return;
         }
-
-        if (!tick())  // virtual function
-            return;
-
-        SDL_Flip(theSDLScreen);
-
-        // Pause for the rest of the current animation frame.
-        Uint32 limit = lastTime + millisecondsPerFrame;
-        Uint32 delay = limit - SDL_GetTicks();
-        if (delay <= (Uint32) millisecondsPerFrame)
-            SDL_Delay(delay);
     }
 }
 
@@ -169,11 +1163,11 @@ GameEngine::waitForReactivation()
 {
     // Virtual call: notify derived class that app is now inactive.
     //
-    processActivation(false);
+    dispatchActivation(false);
 
     // Allow effect of drawing commands made by processActivation() to appear.
     //
-    SDL_Flip(theSDLScreen);
+    presentScreen();
 
     // Sleep on SDL event loop until reactivation.
     //
@@ -185,12 +1179,12 @@ GameEngine::waitForReactivation()
         switch (event.type)
         {
             case SDL_QUIT:
-                processActivation(true);  // notify derived class that app is now active
+                dispatchActivation(true);  // notify derived class that app is now active
                 return false;  // ask caller to quit
             case SDL_ACTIVEEVENT:
                 if (event.active.gain != 0)  // if app now active
                 {
-                    processActivation(true);
+                    dispatchActivation(true);
                     return true;  // ask caller to continue
                 }
                 break;
@@ -237,17 +1231,64 @@ GameEngine::loadPixmap(const char **xpmData,
 
     pixmapSize.x = pixmap->w;
     pixmapSize.y = pixmap->h;
+
+    theTelemetry.recordInstant("pixmap load", Sint64(pixmap->w) * pixmap->h);
 }
 
 
 void
 GameEngine::writeString(const char *s, Couple pos, SDL_Surface *surface)
 {
-    assert(fixedWidthFontPixmap != NULL);
+    ProfileScope scope(theProfiler, FrameProfiler::TEXT);
+    assert(fixedWidthFontArray.getNumImages() != 0);
     if (s == NULL)
         return;
     if (surface == NULL)
         surface = theSDLScreen;
+    pos += getViewOffset(surface);
+    Couple fontDim = getFontDimensions();
+    SDL_Surface *fontPixmap = fixedWidthFontArray.getImage(0);
+    const SDL_Rect &fontRect = fixedWidthFontArray.getImageRect(0);  // in case of atlas
+    size_t len = strlen(s);
+    if (len == 0)
+        return;
+
+    // Skip invisible strings, in int so that far away positions
+    // do not wrap around like Sint16.
+    const SDL_Rect &clip = getCullRect(surface);
+    if (pos.x >= clip.x + clip.w || pos.x + int(len) * fontDim.x <= clip.x
+            || pos.y >= clip.y + clip.h || pos.y + fontDim.y <= clip.y)
+        return;
+
+    SDL_Surface *image = NULL;
+    if (isRecordingDraws())
+    {
+        if (surface == theSDLScreen)
+        {
+            simBuffer->addText(s, pos.x, pos.y);
+            return;
+        }
+        // The string cache belongs to the presentation thread.
+    }
+    else if (!bypassingStringCache)
+        image = getCachedString(s, len, fontPixmap, fontRect);
+    if (image != NULL)
+    {
+        SDL_Rect dest = { Sint16(pos.x), Sint16(pos.y), 0, 0 };
+        blitSurface(image, NULL, surface, &dest);
+    }
+    else
+        blitStringChars(s, pos, surface, fontPixmap, fontRect);
+
+    if (surface == theSDLScreen)
+        markDirtyRect(pos.x, pos.y, int(len) * fontDim.x, fontDim.y);
+}
+
+
+void
+GameEngine::blitStringChars(const char *s, Couple pos, SDL_Surface *surface,
+                            SDL_Surface *fontPixmap, const SDL_Rect &fontRect)
+{
     Couple fontDim = getFontDimensions();
     SDL_Rect dest = { Sint16(pos.x), Sint16(pos.y), Uint16(fontDim.x), Uint16(fontDim.y) };
     for (size_t i = 0; s[i] != '\0'; i++, dest.x += Sint16(fontDim.x))
@@ -265,12 +1306,109 @@ GameEngine::writeString(const char *s, Couple pos, SDL_Surface *surface)
             y -= 2;
         y *= fontDim.y;
 
-        SDL_Rect src  = { Sint16(x), Sint16(y), Uint16(fontDim.x), Uint16(fontDim.y) };
-        SDL_BlitSurface(fixedWidthFontPixmap, &src, surface, &dest);
+        SDL_Rect src  = { Sint16(fontRect.x + x), Sint16(fontRect.y + y), Uint16(fontDim.x), Uint16(fontDim.y) };
+        SDL_Rect d = dest;  // blitSurface() may clip it
+        blitSurface(fontPixmap, &src, surface, &d);
+    }
+}
+
+
+SDL_Surface *
+GameEngine::getCachedString(const char *s, size_t len,
+                            SDL_Surface *fontPixmap, const SDL_Rect &fontRect)
+{
+    if (stringCacheBudget == 0)
+        return NULL;
+
+    StringCacheIndex::key_type key(string(s, len), fontPixmap);
+    StringCacheIndex::iterator it = stringCacheIndex.find(key);
+    if (it != stringCacheIndex.end())
+    {
+        // Move the entry to the front of the LRU list.
+        stringCacheList.splice(stringCacheList.begin(), stringCacheList, it->second);
+        return it->second->image;
+    }
+
+    Couple fontDim = getFontDimensions();
+    int width = int(len) * fontDim.x;
+    if (width > 0x7FFF)
+        return NULL;  // too wide for an SDL_Rect
+    const SDL_PixelFormat *fmt = fontPixmap->format;
+    size_t numBytes = size_t(width) * fmt->BytesPerPixel * fontDim.y;
+    if (numBytes > stringCacheBudget)
+        return NULL;
+
+    SDL_Surface *image = SDL_CreateRGBSurface(
+                            SDL_SWSURFACE, width, fontDim.y,
+                            fmt->BitsPerPixel,
+                            fmt->Rmask, fmt->Gmask, fmt->Bmask, fmt->Amask);
+    if (image == NULL)
+        return NULL;
+    if (fmt->palette != NULL)
+        SDL_SetColors(image, fmt->palette->colors, 0, fmt->palette->ncolors);
+
+    /*  Composite the characters so that the image blits like the font:
+        with the same color key, or with the same per-pixel alpha.
+    */
+    if ((fontPixmap->flags & SDL_SRCALPHA) != 0 && fmt->Amask != 0)
+    {
+        // Copy the alpha channel instead of blending with it.
+        Uint8 alpha = fmt->alpha;
+        Uint32 alphaFlags = fontPixmap->flags & (SDL_SRCALPHA | SDL_RLEACCEL);
+        SDL_SetAlpha(fontPixmap, 0, alpha);
+        blitStringChars(s, Couple(0, 0), image, fontPixmap, fontRect);
+        SDL_SetAlpha(fontPixmap, alphaFlags, alpha);
+        SDL_SetAlpha(image, SDL_SRCALPHA | SDL_RLEACCEL, alpha);
+    }
+    else
+    {
+        if ((fontPixmap->flags & SDL_SRCCOLORKEY) != 0)
+        {
+            SDL_FillRect(image, NULL, fmt->colorkey);
+            SDL_SetColorKey(image, SDL_SRCCOLORKEY | SDL_RLEACCEL, fmt->colorkey);
+        }
+        blitStringChars(s, Couple(0, 0), image, fontPixmap, fontRect);
+        if ((fontPixmap->flags & SDL_SRCALPHA) != 0)  // per-surface alpha
+            SDL_SetAlpha(image, SDL_SRCALPHA | SDL_RLEACCEL, fmt->alpha);
+    }
+
+    evictStrings(stringCacheBudget - numBytes);
+
+    CachedString cs;
+    cs.text = key.first;
+    cs.font = fontPixmap;
+    cs.image = image;
+    cs.numBytes = numBytes;
+    stringCacheList.push_front(cs);
+    stringCacheIndex[key] = stringCacheList.begin();
+    stringCacheSize += numBytes;
+    return image;
+}
+
+
+void
+GameEngine::evictStrings(size_t budget)
+{
+    while (stringCacheSize > budget)
+    {
+        assert(!stringCacheList.empty());
+        const CachedString &cs = stringCacheList.back();
+        stringCacheIndex.erase(make_pair(cs.text, cs.font));
+        stringCacheSize -= cs.numBytes;
+        SDL_FreeSurface(cs.image);
+        stringCacheList.pop_back();
     }
 }
 
 
+void
+GameEngine::setStringCacheBudget(size_t numBytes)
+{
+    stringCacheBudget = numBytes;
+    evictStrings(numBytes);
+}
+
+
 void
 GameEngine::writeStringCentered(const char *s, Couple pos, SDL_Surface *surface)
 {
@@ -305,44 +1443,6 @@ GameEngine::writeStringRightJustified(
 ///////////////////////////////////////////////////////////////////////////////
 
 
-void
-GameEngine::putpixel(SDL_Surface *surface, int x, int y, Uint32 pixel)
-{
-    int bpp = surface->format->BytesPerPixel;
-    Uint8 *p = (Uint8 *) surface->pixels + y * surface->pitch + x * bpp;
-
-    switch (bpp)
-    {
-        case 1:
-            *p = Uint8(pixel);
-            break;
-
-        case 2:
-            * (Uint16 *) p = Uint16(pixel);
-            break;
-
-        case 3:
-            if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
-            {
-                p[0] = Uint8((pixel >> 16) & 0xFF);
-                p[1] = Uint8((pixel >> 8) & 0xFF);
-                p[2] = Uint8(pixel & 0xFF);
-            }
-            else
-            {
-                p[0] = Uint8(pixel & 0xFF);
-                p[1] = Uint8((pixel >> 8) & 0xFF);
-                p[2] = Uint8((pixel >> 16) & 0xFF);
-            }
-            break;
-
-        case 4:
-            * (Uint32 *) p = pixel;
-            break;
-    }
-}
-
-
 void
 GameEngine::initWuLineAlgorithm()
 {
@@ -352,68 +1452,321 @@ GameEngine::initWuLineAlgorithm()
     for (size_t i=0; i<numLevelsGammaTable; i++)
         gamma_table[i] = (unsigned char) ((numLevelsGammaTable - 1) * pow(
                     i / (double) (numLevelsGammaTable - 1), 1.0 / Draw_gamma));
+
+    for (size_t i = 0; i < NUM_WU_RAMPS; i++)
+        wuRamps[i].format = NULL;
 }
 
 
-// Source: http://mail.lokigames.com/ml/sdl/0288.html
-//
-void
-GameEngine::wu_line(SDL_Surface *surface,
-                    Uint32 x0, Uint32 y0, Uint32 x1, Uint32 y1,
-                    Uint32 fgc, Uint32 bgc)
+const Uint32 *
+GameEngine::getWuColorRamp(SDL_Surface *surface, Uint32 fgc, Uint32 bgc)
 {
   const int nlevels = 256;
-  const int nbits = 8;
 
-  Uint32 intshift, erracc,erradj;
-  Uint32 erracctmp, wgt, wgtcompmask;
-  int dx, dy, tmp, xdir, i;
-  Uint32 colors[nlevels];
-  SDL_Rect r;
-  SDL_Color fg, bg;
+  for (size_t k = 0; k < NUM_WU_RAMPS; k++) {
+    const WuColorRamp &ramp = wuRamps[k];
+    if (ramp.format == surface->format && ramp.fg == fgc && ramp.bg == bgc)
+      return ramp.colors;
+  }
+
+  WuColorRamp &ramp = wuRamps[nextWuRamp];
+  nextWuRamp = (nextWuRamp + 1) % NUM_WU_RAMPS;
 
+  SDL_Color fg, bg;
   SDL_GetRGB(fgc, surface->format, &fg.r, &fg.g, &fg.b);
   SDL_GetRGB(bgc, surface->format, &bg.r, &bg.g, &bg.b);
 
   /* generate the colors by linear interpolation, applying gamma correction */
-  for (i=0; i<nlevels; i++) {
+  for (int i=0; i<nlevels; i++) {
     Uint8 r, g, b;
 
     r = gamma_table[fg.r - (i*(fg.r - bg.r))/(nlevels-1)];
     g = gamma_table[fg.g - (i*(fg.g - bg.g))/(nlevels-1)];
     b = gamma_table[fg.b - (i*(fg.b - bg.b))/(nlevels-1)];
-    colors[i] = SDL_MapRGB(surface->format, r, g, b);
+    ramp.colors[i] = SDL_MapRGB(surface->format, r, g, b);
   }
+  ramp.fg = fgc;
+  ramp.bg = bgc;
+  ramp.format = surface->format;
+  return ramp.colors;
+}
+
+
+/*  Clips the segment from p1 to p2 to the rectangle whose corners are
+    (xMin, yMin) and (xMax, yMax), inclusively, with the Cohen-Sutherland
+    algorithm. Returns false if no part of the segment is inside.
+*/
+static bool
+clipSegment(Couple &p1, Couple &p2, int xMin, int yMin, int xMax, int yMax)
+{
+    enum { LEFT = 1, RIGHT = 2, TOP = 4, BOTTOM = 8 };
+    for (;;)
+    {
+        int code1 = (p1.x < xMin ? LEFT : p1.x > xMax ? RIGHT : 0)
+                  | (p1.y < yMin ? TOP : p1.y > yMax ? BOTTOM : 0);
+        int code2 = (p2.x < xMin ? LEFT : p2.x > xMax ? RIGHT : 0)
+                  | (p2.y < yMin ? TOP : p2.y > yMax ? BOTTOM : 0);
+        if ((code1 | code2) == 0)
+            return true;
+        if ((code1 & code2) != 0)
+            return false;
+
+        // Move an outside end point to the edge that it is beyond.
+        // In 64 bits, because world coordinates can be far apart.
+        int code = (code1 != 0 ? code1 : code2);
+        Sint64 dx = Sint64(p2.x) - p1.x, dy = Sint64(p2.y) - p1.y;
+        Couple p;
+        if (code & TOP)
+            p = Couple(int(p1.x + dx * (Sint64(yMin) - p1.y) / dy), yMin);
+        else if (code & BOTTOM)
+            p = Couple(int(p1.x + dx * (Sint64(yMax) - p1.y) / dy), yMax);
+        else if (code & LEFT)
+            p = Couple(xMin, int(p1.y + dy * (Sint64(xMin) - p1.x) / dx));
+        else
+            p = Couple(xMax, int(p1.y + dy * (Sint64(xMax) - p1.x) / dx));
+        (code1 != 0 ? p1 : p2) = p;
+    }
+}
+
+
+void
+GameEngine::drawLines(const Couple *endPoints, size_t numEndPoints, Uint32 color)
+{
+    if (numEndPoints < 2)
+        return;
+    Couple offset = getViewOffset(theSDLScreen);
+    if (isRecordingDraws())
+    {
+        simBuffer->addLines(endPoints, numEndPoints, color, offset);
+        return;
+    }
+
+    const Uint32 *colors = getWuColorRamp(theSDLScreen, color, 0);
+
+    if (SDL_MUSTLOCK(theSDLScreen) && SDL_LockSurface(theSDLScreen) != 0)
+        return;
+
+    // Wu's algorithm does not clip: it stays within the bounding box
+    // of the end points, so the lines are clipped beforehand.
+    const SDL_Rect &clip = theSDLScreen->clip_rect;
+    for (size_t i = 0; i + 1 < numEndPoints; i += 2)
+    {
+        Couple p1 = endPoints[i] + offset;
+        Couple p2 = endPoints[i + 1] + offset;
+        if (!clipSegment(p1, p2, clip.x, clip.y,
+                         clip.x + clip.w - 1, clip.y + clip.h - 1))
+            continue;
+        theWriters.line(theSDLScreen, Uint32(p1.x), Uint32(p1.y),
+                                      Uint32(p2.x), Uint32(p2.y), color, colors);
+
+        // Wu's algorithm may paint the pixel to the right of or below
+        // the ideal line, hence the extra column and row.
+        if (usingDirtyRects)
+            markDirtyRect(min(p1.x, p2.x), min(p1.y, p2.y),
+                          abs(p2.x - p1.x) + 2, abs(p2.y - p1.y) + 2);
+    }
+
+    if (SDL_MUSTLOCK(theSDLScreen))
+        SDL_UnlockSurface(theSDLScreen);
+}
+
+
+void
+GameEngine::drawPixels(const Couple *points, size_t numPoints, Uint32 color)
+{
+    if (numPoints == 0)
+        return;
+    Couple offset = getViewOffset(theSDLScreen);
+    if (isRecordingDraws())
+    {
+        simBuffer->addPixels(points, numPoints, color, offset);
+        return;
+    }
+    if (SDL_MUSTLOCK(theSDLScreen) && SDL_LockSurface(theSDLScreen) != 0)
+        return;
+
+    const SDL_Rect &clip = theSDLScreen->clip_rect;
+    const int right = clip.x + clip.w, bottom = clip.y + clip.h;
+    int minX = right, minY = bottom, maxX = clip.x - 1, maxY = clip.y - 1;
+
+    for (size_t i = 0; i < numPoints; i++)
+    {
+        int x = points[i].x + offset.x, y = points[i].y + offset.y;
+        if (x < clip.x || x >= right || y < clip.y || y >= bottom)
+            continue;
+        theWriters.pixel(theSDLScreen, x, y, color);
+        minX = min(minX, x);
+        maxX = max(maxX, x);
+        minY = min(minY, y);
+        maxY = max(maxY, y);
+    }
+
+    if (SDL_MUSTLOCK(theSDLScreen))
+        SDL_UnlockSurface(theSDLScreen);
+
+    markDirtyRect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+}
+
+
+void
+GameEngine::drawSpans(const Span *spans, size_t numSpans, Uint32 color)
+{
+    if (numSpans == 0)
+        return;
+    Couple offset = getViewOffset(theSDLScreen);
+    if (isRecordingDraws())
+    {
+        simBuffer->addSpans(color);
+        for (size_t i = 0; i < numSpans; i++)
+            simBuffer->addSpan(spans[i].x + offset.x, spans[i].y + offset.y,
+                               spans[i].width);
+        return;
+    }
+    if (SDL_MUSTLOCK(theSDLScreen) && SDL_LockSurface(theSDLScreen) != 0)
+        return;
+
+    const SDL_Rect &clip = theSDLScreen->clip_rect;
+    const int right = clip.x + clip.w, bottom = clip.y + clip.h;
+    int minX = right, minY = bottom, maxX = clip.x - 1, maxY = clip.y - 1;
+
+    for (size_t i = 0; i < numSpans; i++)
+    {
+        int y = spans[i].y + offset.y;
+        if (y < clip.y || y >= bottom)
+            continue;
+        int x = max(spans[i].x + offset.x, int(clip.x));
+        int xEnd = min(spans[i].x + offset.x + spans[i].width, right);
+        if (x >= xEnd)
+            continue;
+        theWriters.span(theSDLScreen, x, y, xEnd - x, color);
+        minX = min(minX, x);
+        maxX = max(maxX, xEnd - 1);
+        minY = min(minY, y);
+        maxY = max(maxY, y);
+    }
+
+    if (SDL_MUSTLOCK(theSDLScreen))
+        SDL_UnlockSurface(theSDLScreen);
+
+    markDirtyRect(minX, minY, maxX - minX + 1, maxY - minY + 1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+//  Pixel writers specialized for each number of bytes per pixel.
+//  setVideoMode() selects the set that matches the screen, so that the
+//  inner loops do not have to test the pixel format of each pixel.
+//  The surface must be locked if needed, and the coordinates must be
+//  inside the surface.
+
+
+template <int bpp> inline void storePixel(Uint8 *p, Uint32 pixel);
+
+template <> inline void
+storePixel<1>(Uint8 *p, Uint32 pixel)
+{
+    *p = Uint8(pixel);
+}
+
+template <> inline void
+storePixel<2>(Uint8 *p, Uint32 pixel)
+{
+    * (Uint16 *) p = Uint16(pixel);
+}
+
+template <> inline void
+storePixel<3>(Uint8 *p, Uint32 pixel)
+{
+    if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+    {
+        p[0] = Uint8((pixel >> 16) & 0xFF);
+        p[1] = Uint8((pixel >> 8) & 0xFF);
+        p[2] = Uint8(pixel & 0xFF);
+    }
+    else
+    {
+        p[0] = Uint8(pixel & 0xFF);
+        p[1] = Uint8((pixel >> 8) & 0xFF);
+        p[2] = Uint8((pixel >> 16) & 0xFF);
+    }
+}
+
+template <> inline void
+storePixel<4>(Uint8 *p, Uint32 pixel)
+{
+    * (Uint32 *) p = pixel;
+}
+
+
+template <int bpp>
+static void
+putPixel(SDL_Surface *surface, int x, int y, Uint32 pixel)
+{
+    storePixel<bpp>((Uint8 *) surface->pixels + y * surface->pitch + x * bpp, pixel);
+}
+
+
+template <int bpp>
+static void
+fillSpan(SDL_Surface *surface, int x, int y, int width, Uint32 pixel)
+{
+    Uint8 *p = (Uint8 *) surface->pixels + y * surface->pitch + x * bpp;
+    for (Uint8 *end = p + width * bpp; p != end; p += bpp)
+        storePixel<bpp>(p, pixel);
+}
+
+
+// Source: http://mail.lokigames.com/ml/sdl/0288.html
+//
+template <int bpp>
+static void
+wuLine(SDL_Surface *surface,
+       Uint32 x0, Uint32 y0, Uint32 x1, Uint32 y1,
+       Uint32 fgc, const Uint32 *colors)
+{
+  const int nlevels = 256;
+  const int nbits = 8;
+
+  Uint32 intshift, erracc,erradj;
+  Uint32 erracctmp, wgt, wgtcompmask;
+  int dx, dy, tmp, xdir;
+
   if (y0 > y1) {
     tmp = y0; y0 = y1; y1 = tmp;
     tmp = x0; x0 = x1; x1 = tmp;
   }
   /* draw the initial pixel in the foreground color */
-  putpixel(surface, x0, y0, fgc);
+  putPixel<bpp>(surface, x0, y0, fgc);
 
   dx = x1 - x0;
   xdir = (dx >= 0) ? 1 : -1;
   dx = (dx >= 0) ? dx : -dx;
 
   /* special-case horizontal, vertical, and diagonal lines which need no
-     weighting because they go right through the center of every pixel. */
+     weighting because they go right through the center of every pixel.
+     The surface is locked, so SDL_FillRect() cannot be used. */
+  const SDL_Rect &clip = surface->clip_rect;
   if ((dy = y1 - y0) == 0) {
-    /* horizontal line */
-    r.x = (x0 < x1) ? x0 : x1;
-    r.y = y0;
-    r.w = dx;
-    r.h = 1;
-    SDL_FillRect(surface, &r, fgc);
+    /* horizontal line, clipped like SDL_FillRect() would do */
+    int x = (x0 < x1) ? x0 : x1;
+    int xEnd = min(x + dx, clip.x + clip.w);
+    x = max(x, int(clip.x));
+    if (int(y0) < clip.y || int(y0) >= clip.y + clip.h || x >= xEnd)
+      return;
+    fillSpan<bpp>(surface, x, y0, xEnd - x, fgc);
     return;
   }
 
   if (dx == 0) {
-    /* vertical line */
-    r.x = x0;
-    r.y = y0;
-    r.w = 1;
-    r.h = dy;
-    SDL_FillRect(surface, &r, fgc);
+    /* vertical line, clipped like SDL_FillRect() would do */
+    int y = y0;
+    int yEnd = min(y + dy, clip.y + clip.h);
+    y = max(y, int(clip.y));
+    if (int(x0) < clip.x || int(x0) >= clip.x + clip.w)
+      return;
+    for (; y < yEnd; y++)
+      putPixel<bpp>(surface, x0, y, fgc);
     return;
   }
 
@@ -421,7 +1774,7 @@ GameEngine::wu_line(SDL_Surface *surface,
     for (; dy != 0; dy--) {
       x0 += xdir;
       y0++;
-      putpixel(surface, x0, y0, fgc);
+      putPixel<bpp>(surface, x0, y0, fgc);
     }
     return;
   }
@@ -450,12 +1803,12 @@ GameEngine::wu_line(SDL_Surface *surface,
          weighting for this pixel, and the complement of the weighting for
          the paired pixel. */
       wgt = erracc >> intshift;
-      putpixel(surface, x0, y0, colors[wgt]);
-      putpixel(surface, x0+xdir, y0, colors[wgt^wgtcompmask]);
+      putPixel<bpp>(surface, x0, y0, colors[wgt]);
+      putPixel<bpp>(surface, x0+xdir, y0, colors[wgt^wgtcompmask]);
     }
     /* draw the final pixel, which is always exactly intersected by the line
        and so needs no weighting */
-    putpixel(surface, x1, y1, fgc);
+    putPixel<bpp>(surface, x1, y1, fgc);
     return;
   }
   /* x-major line.  Calculate 16-bit fixed-point fractional part of a pixel
@@ -475,10 +1828,36 @@ GameEngine::wu_line(SDL_Surface *surface,
        weighting for this pixel, and the complement of the weighting for
        the paired pixel. */
     wgt = erracc >> intshift;
-    putpixel(surface, x0, y0, colors[wgt]);
-    putpixel(surface, x0, y0+1, colors[wgt^wgtcompmask]);
+    putPixel<bpp>(surface, x0, y0, colors[wgt]);
+    putPixel<bpp>(surface, x0, y0+1, colors[wgt^wgtcompmask]);
   }
   /* draw final pixel, always exactly intersected by the line and doesn't
      need to be weighted. */
-  putpixel(surface, x1, y1, fgc);
+  putPixel<bpp>(surface, x1, y1, fgc);
+}
+
+
+/*static*/
+GameEngine::PixelWriters
+GameEngine::getPixelWriters(int bytesPerPixel)
+{
+    PixelWriters w;
+    switch (bytesPerPixel)
+    {
+        case 1:
+            w.pixel = putPixel<1>; w.span = fillSpan<1>; w.line = wuLine<1>;
+            break;
+        case 2:
+            w.pixel = putPixel<2>; w.span = fillSpan<2>; w.line = wuLine<2>;
+            break;
+        case 3:
+            w.pixel = putPixel<3>; w.span = fillSpan<3>; w.line = wuLine<3>;
+            break;
+        default:
+            assert(bytesPerPixel == 4);
+            w.pixel = putPixel<4>; w.span = fillSpan<4>; w.line = wuLine<4>;
+            break;
+    }
+    return w;
 }
+
@@ -23,12 +23,24 @@
 #ifndef _H_GameEngine
 #define _H_GameEngine
 
+#include <flatzebra/ColorKeyBlitter.h>
 #include <flatzebra/Couple.h>
+#include <flatzebra/DrawCommandBuffer.h>
+#include <flatzebra/DrawList.h>
+#include <flatzebra/FramePacer.h>
+#include <flatzebra/FrameProfiler.h>
+#include <flatzebra/InputLog.h>
+#include <flatzebra/JobSystem.h>
 #include <flatzebra/RCouple.h>
 #include <flatzebra/Sprite.h>
 #include <flatzebra/RSprite.h>
+#include <flatzebra/ScrollingBackground.h>
+#include <flatzebra/TelemetryRecorder.h>
+#include <flatzebra/TileMap.h>
+#include <flatzebra/Viewport.h>
 
 #include <flatzebra/PixmapArray.h>
+#include <flatzebra/PixmapAtlas.h>
 #include <flatzebra/PixmapLoadError.h>
 /*  Include directive instead of forward declaration, because of the
     exception specifications that mention PixmapLoadError.
@@ -39,7 +51,12 @@
 #include <SDL_types.h>
 #include <SDL_keysym.h>
 
+#include <stdlib.h>
+#include <algorithm>
 #include <string>
+#include <vector>
+#include <list>
+#include <map>
 
 
 namespace flatzebra {
@@ -54,7 +71,8 @@ public:
     GameEngine(Couple screenSizeInPixels,
                 const std::string &wmCaption,
                 bool fullScreen,
-                bool processActiveEvent)
+                bool processActiveEvent,
+                bool headless = false)
                         throw(std::string);
     /*  Initializes SDL and an adequate video mode.
 
@@ -74,6 +92,13 @@ public:
         processed, and the virtual method processActivation() is called
         when the app loses and regains focus.
 
+        If 'headless' is true, no window is opened and SDL's video
+        subsystem is not initialized: theSDLScreen is a 32-bit memory
+        surface, presentScreen() only saves the frame if setFrameDump()
+        has been called, and no events are received, so the game stops
+        when tick() returns false. This allows running a game on a
+        machine without a display, e.g., for tests and benchmarks.
+
         The run() method should be called after successfully constructing
         this object.
     */
@@ -86,6 +111,20 @@ public:
     /*  Changes the current video mode to the given resolution and screen mode.
         Returns an empty string upon success, or a non-empty error message
         otherwise.
+        If the pixel format of the screen changes, the display format
+        copies of all PixmapArray objects are regenerated.
+    */
+
+    bool isHeadless() const;
+    /*  Indicates if this engine was constructed in headless mode.
+    */
+
+    void setFrameDump(const std::string &filePrefix);
+    /*  In headless mode, makes presentScreen() save each frame in a
+        BMP file named 'filePrefix' followed by a 6-digit frame number
+        and ".bmp", e.g., "frames/f000042.bmp".
+        An empty prefix disables the saving, which is the default.
+        Not used outside of headless mode.
     */
 
     bool inFullScreenMode() const;
@@ -130,6 +169,140 @@ public:
         between the start of each frame of animation.  50 ms means
         20 frames per second, which is about the minimum speed needed
         to fool the human eye into seeing smooth motion.
+        If 'millisecondsPerFrame' is zero, the frames are not paced:
+        tick() is called as often as possible.
+    */
+
+    void runFixedStep(int ticksPerSecond = 60,
+                      int maxFramesPerSecond = 0,
+                      int maxTicksPerFrame = 5);
+    /*  Main loop that decouples the simulation rate from the display rate.
+        To be called instead of run().
+        Runs until the user asks to quit the program.
+
+        tick() is called exactly 'ticksPerSecond' times per second of
+        elapsed time, as measured by MonotonicClock. After the ticks
+        that are due, render() is called once, then the screen
+        is presented.
+        If more than 'maxTicksPerFrame' ticks are due, for example
+        because the machine is too slow or because the app was inactive,
+        the extra ticks are dropped so that the game slows down instead
+        of trying to catch up forever.
+        If 'maxFramesPerSecond' is positive, the loop sleeps as needed
+        to present at most that many frames per second. Otherwise,
+        frames are presented as fast as SDL_Flip() allows.
+    */
+
+    void runThreaded(int millisecondsPerFrame = 50);
+    /*  Main loop that runs the game logic and the presentation of the
+        frames on two threads.
+        To be called instead of run(). Runs until the user asks to quit
+        the program, or until tick() returns false.
+
+        processKey(), tick() and processActivation() are called on
+        a simulation thread, at the rate given by 'millisecondsPerFrame'
+        as with run(). The drawing that they do on theSDLScreen with
+        copyPixmap(), copySpritePixmap(), writeString(), drawPixel(),
+        drawPixels(), drawSpans(), drawLine(), drawLines(), fillRect()
+        and markDirtyRect() is not done immediately: it is recorded
+        and published at the end of each tick. The calling thread
+        performs the recorded drawing and presents the screen,
+        while the simulation thread proceeds with the next tick.
+        If the simulation thread publishes a frame before the previous
+        one has been presented, the two are presented together, so no
+        drawing is ever lost.
+
+        In this mode, the game must not access theSDLScreen in other
+        ways from these methods, and it must not call setVideoMode().
+        Drawing on other surfaces is done immediately, on the simulation
+        thread.
+        The pixmaps drawn on the screen must remain valid until the
+        end of the next frame.
+        Falls back to run() if the thread cannot be created.
+    */
+
+    JobSystem &getJobSystem();
+    /*  Returns the scheduler that games can use to spread the work of
+        tick() over the processors, e.g., with JobSystem::parallelForEach()
+        on a SpriteList.
+        Its worker threads are started by the constructor: one per
+        processor, minus one for the thread that calls tick(), which
+        also executes jobs while it waits for them.
+    */
+
+    FrameProfiler &getProfiler();
+    /*  Returns the profiler that times the phases of each frame of
+        run(), runFixedStep() and runThreaded(): event processing,
+        tick(), render(), blits, text, presentation and waiting.
+        It is disabled by default. A game can register its own phases
+        and time parts of tick() with ProfileScope.
+        Each phase is charged its self time: the blits and text drawn
+        by tick() are counted in those phases, not in the tick phase.
+        With runThreaded(), only the presentation thread is timed.
+    */
+
+    void setProfilerOverlay(bool show);
+    /*  Selects whether a graph of the recent frame times and the median
+        and 99th percentile of each phase are drawn in the upper-left
+        corner of the screen before each presentation.
+        Showing the overlay enables the profiler.
+    */
+
+    TelemetryRecorder &getTelemetry();
+    /*  Returns the recorder of the engine's timeline: the beginning and
+        end of each frame, tick() and presentation, the number of blits
+        on the screen per frame, and pixmap loads. It also records the
+        sounds played by a SoundMixer on which setTelemetryRecorder()
+        has been called with it.
+        It is disabled by default. Call TelemetryRecorder::flush()
+        to write the recent history to a file.
+    */
+
+    void setTelemetryExitFile(const std::string &fileName,
+                              TelemetryRecorder::Format format);
+    /*  Requests that the destructor write the events still in the
+        telemetry recorder to the named file.
+        An empty name cancels the request.
+    */
+
+    const FramePacer &getFramePacer() const;
+    /*  Returns the object that paces the frames of run() and
+        runFixedStep(). Its statistics tell how late the frames have
+        been with respect to their schedule.
+    */
+
+    void setInputLog(InputLog *log);
+    /*  Attaches an input log, or detaches it if 'log' is NULL, and
+        restarts the tick count at zero. The log is not owned.
+        If the log is recording, the key and activation events passed
+        to processKey() and processActivation(), and the end of the
+        session, are appended to it with the number of the tick that
+        follows them.
+        If the log is replaying, the live key and activation events are
+        ignored: the logged ones are passed to processKey() and
+        processActivation() just before the ticks with the same numbers,
+        and the game loop ends at the tick where the recording ended.
+        To log joystick input as well, call Joystick::attachInputLog().
+        The game must start from the same state, including the seed
+        of its random numbers, when recording and replaying.
+        With run(0), a replay is a repeatable workload that can be timed.
+    */
+
+    Uint32 getTickCount() const;
+    /*  Returns the number of calls to tick() since construction or
+        since the last call to setInputLog().
+    */
+
+    virtual void render(double alpha);
+    /*  Called by runFixedStep() once per displayed frame, after the
+        calls to tick() that were due.
+        'alpha' is in [0, 1): it is the fraction of a tick period that
+        has elapsed since the last tick. A game that draws in this
+        method can interpolate each object between its previous and
+        current positions with this fraction, so that motion looks
+        smooth when the display rate differs from the tick rate.
+        This method does nothing; a game that draws in tick() does
+        not need to override it.
     */
 
     int getScreenWidthInPixels() const;
@@ -137,6 +310,75 @@ public:
     /*  Mumble.
     */
 
+    void setDirtyRectMode(bool enable);
+    bool inDirtyRectMode() const;
+    /*  Selects or queries the dirty rectangle presentation mode.
+        This mode is off by default, in which case run() presents each
+        frame with SDL_Flip(), i.e., the whole screen is uploaded.
+        When this mode is on, copyPixmap(), copySpritePixmap(),
+        writeString(), drawPixel(), drawLine() and fillRect() record
+        the screen regions that they modify, and run() only presents
+        those regions with SDL_UpdateRects().
+        A game that draws on theSDLScreen by other means must call
+        markDirtyRect() on the affected regions.
+        Changing the mode forces the next frame to be fully presented.
+    */
+
+    void setNativeBlits(bool enable);
+    bool usingNativeBlits() const;
+    /*  Selects or queries the use of ColorKeyBlitter instead of
+        SDL_BlitSurface() by copyPixmap(), copySpritePixmap() and
+        writeString(), for images at most
+        ColorKeyBlitter::MAX_SPRITE_WIDTH pixels wide whose pixel format
+        is that of the destination (see ColorKeyBlitter::canBlit()).
+        This is on by default.
+    */
+
+    void setViewport(const Viewport *viewport);
+    const Viewport *getViewport() const;
+    /*  Selects the Viewport through which the screen shows the world,
+        or none if 'viewport' is null, which is the default.
+        While a viewport is selected, copyPixmap(), copySpritePixmap(),
+        submitPixmap(), submitSprite(), writeString() and its variants,
+        drawPixel(), drawPixels(), drawSpans(), drawLine(), drawLines()
+        and fillRect() take world coordinates when they draw on the
+        screen, and their drawing is clipped to the screen rectangle
+        of the viewport (with SDL_SetClipRect()).
+        The origin of the viewport is read at each call, so scrolling
+        only requires changing it. markDirtyRect() always takes screen
+        coordinates.
+        Select no viewport to draw a HUD in screen coordinates.
+        The viewport is not owned. It must remain valid while selected.
+        With runThreaded(), the clipping is recorded like the drawing.
+    */
+
+    unsigned long getNumBlitsDrawn() const;
+    unsigned long getNumBlitsCulled() const;
+    void resetBlitCounters();
+    /*  copyPixmap(), copySpritePixmap(), submitPixmap() and submitSprite()
+        skip the images that are entirely outside of the clipping
+        rectangle of the destination surface (the whole surface unless
+        SDL_SetClipRect() was used), before any other work.
+        These methods count the images drawn and the images skipped
+        since construction or since the last call to resetBlitCounters().
+        With runThreaded(), they are counted on the simulation thread.
+    */
+
+    void setStringCacheBudget(size_t numBytes);
+    size_t getStringCacheBudget() const;
+    size_t getStringCacheSize() const;
+    /*  writeString() and its variants keep the strings that they have
+        drawn in a cache of pre-composited surfaces, so that drawing a
+        string that was recently drawn only takes one blit.
+        The least recently used strings are discarded when the pixel
+        memory of the cache would exceed the budget.
+        The default budget is DEFAULT_STRING_CACHE_BUDGET bytes.
+        A budget of zero disables the cache.
+        getStringCacheSize() returns the number of bytes currently used.
+    */
+
+    enum { DEFAULT_STRING_CACHE_BUDGET = 256 * 1024 };
+
 protected:
 
     Couple theScreenSizeInPixels;
@@ -153,9 +395,67 @@ protected:
 
     bool processActiveEvent;  // if true, SDL_ACTIVEEVENT is processed by run()
 
+    bool headless;  // if true, theSDLScreen is a memory surface
+    std::string frameDumpPrefix;  // empty if frames are not saved
+    unsigned long numDumpedFrames;
+
+    PixmapArray fixedWidthFontArray;
+        // owner of the font image; fixedWidthFontPixmap is its display
+        // format copy
+
     // Wu's line algorithm:
     unsigned char gamma_table[256];
 
+    struct WuColorRamp
+    {
+        Uint32 fg, bg;  // colors in 'format'
+        const SDL_PixelFormat *format;  // NULL if this ramp is unused
+        Uint32 colors[256];  // from fg to bg, gamma corrected
+    };
+    enum { NUM_WU_RAMPS = 8 };
+    WuColorRamp wuRamps[NUM_WU_RAMPS];  // cache used by getWuColorRamp()
+    size_t nextWuRamp;  // next element of wuRamps[] to be replaced
+
+    FramePacer thePacer;  // used by run(), runFixedStep() and runThreaded()
+
+    mutable TelemetryRecorder theTelemetry;  // mutable: pixmap loads are recorded by const methods
+    std::string telemetryExitFileName;  // empty if no file is written at exit
+    TelemetryRecorder::Format telemetryExitFormat;
+    mutable size_t numScreenBlits;  // during the current frame
+    mutable unsigned long numBlitsDrawn;  // see getNumBlitsDrawn()
+    mutable unsigned long numBlitsCulled;
+
+    JobSystem theJobSystem;
+
+    mutable FrameProfiler theProfiler;  // mutable: blits are timed by const methods
+    bool showingProfilerOverlay;
+
+    bool nativeBlits;
+
+    DrawList theDrawList;  // see submitSprite()
+
+    bool usingDirtyRects;
+    mutable std::vector<SDL_Rect> dirtyRects;
+        // screen regions modified since the last presentation;
+        // pairwise disjoint; only used in dirty rectangle mode
+
+    // Cache of the strings drawn by writeString():
+    struct CachedString
+    {
+        std::string text;
+        SDL_Surface *font;   // font pixmap used to composite 'image'
+        SDL_Surface *image;  // owned; same format as 'font'
+        size_t numBytes;     // pixel memory of 'image'
+    };
+    typedef std::list<CachedString> StringCacheList;
+    typedef std::map<std::pair<std::string, SDL_Surface *>,
+                     StringCacheList::iterator> StringCacheIndex;
+    StringCacheList stringCacheList;  // most recently used first
+    StringCacheIndex stringCacheIndex;  // key is (text, font)
+    size_t stringCacheSize;  // sum of numBytes in stringCacheList
+    size_t stringCacheBudget;
+    bool bypassingStringCache;  // for text that changes every frame
+
 protected:
 
     void loadPixmap(const char **xpmData,
@@ -169,11 +469,16 @@ protected:
         Throws an exception to signal errors.
         Upon success, the caller is responsible for freeing the surface
         by calling SDL_FreeSurface().
+        When a PixmapArray is given, it also keeps a copy of the pixmap
+        in the display format (see PixmapArray::convertToDisplayFormat()).
     */
 
     void copyPixmap(SDL_Surface *src, Couple dest,
                             SDL_Surface *surface = NULL) const;
-    /*  Copies 'src' at the specified destination in the drawing pixmap.
+    void copyPixmap(const PixmapArray &pa, size_t pixmapNo, Couple dest,
+                            SDL_Surface *surface = NULL) const;
+    /*  Copies 'src', or image number 'pixmapNo' of 'pa', at the specified
+        destination in the drawing pixmap.
         If 'surface' is null, the visible screen is used.
     */
 
@@ -189,6 +494,53 @@ protected:
         at the specified position.
         Uses the sprite's size but not its position.
         If 'surface' is null, the visible screen is used.
+        Works whether or not the sprite's PixmapArray is in a PixmapAtlas.
+    */
+
+    void submitPixmap(const PixmapArray &pa, size_t pixmapNo, Couple dest,
+                      int layer = 0);
+    void submitSprite(const Sprite &s, size_t pixmapNo, Couple posInSurface,
+                      int layer = 0);
+    void submitSprite(const RSprite &s, size_t pixmapNo, RCouple posInSurface,
+                      int layer = 0);
+    /*  Same as copyPixmap() and copySpritePixmap() on the screen, but the
+        blit is only added to the frame's draw list (see DrawList),
+        to be performed by the next call to flushDrawList().
+        Layers are drawn in increasing order. Within a layer, the blits
+        are grouped by source surface; those from a same surface are
+        drawn in the order in which they were submitted.
+        Each blit is clipped to the clipping rectangle that the screen
+        has when it is submitted, e.g., that of the viewport selected
+        then (see setViewport()), not when the draw list is flushed.
+        The pixmaps must remain valid until the draw list is flushed.
+    */
+
+    void copyBackground(ScrollingBackground &bg);
+    /*  Brings 'bg' up to date for the origin of the selected viewport,
+        or for (0, 0) if none is selected (see setViewport()), and copies
+        it onto the screen at that origin, i.e., over the viewport.
+        Not for use with runThreaded(): the presentation of the previous
+        frame may still be reading the surface that 'bg' redraws.
+    */
+
+    void copyTileMap(TileMap &map, Couple pos = Couple());
+    /*  Copies onto the screen the chunks of 'map' that are visible when
+        its upper-left corner is at 'pos', rendering those that need it
+        (see TileMap::getChunkSurface()). Only the chunks that overlap
+        the clipping rectangle are looked at, so the cost depends on the
+        size of the screen, not on that of the map.
+        'pos' is in world coordinates if a viewport is selected
+        (see setViewport()).
+        With runThreaded(), the tiles of a chunk that has been drawn
+        must not be changed until the end of the next frame.
+    */
+
+    void flushDrawList();
+    /*  Sorts the blits submitted since the previous call and performs
+        them in one pass, choosing the blitter once per source surface.
+        run(), runFixedStep() and runThreaded() call this method after
+        tick() and render(), so a game only needs to call it to draw
+        something, e.g., a HUD, over the submitted sprites.
     */
 
     void writeString(const char *s, Couple pos,
@@ -221,6 +573,21 @@ protected:
     void drawPixel(int x, int y, Uint32 color);
     /*  Sets the color of the pixel at the given position.
         The upper-left corner of the game screen is at (0, 0).
+        Does nothing if the position is outside of the screen.
+    */
+
+    struct Span
+    {
+        int x, y;   // leftmost pixel
+        int width;  // number of pixels
+    };
+
+    void drawPixels(const Couple *points, size_t numPoints, Uint32 color);
+    void drawSpans(const Span *spans, size_t numSpans, Uint32 color);
+    /*  Sets the color of many pixels, or of many horizontal runs of
+        pixels, at once. The screen is locked only once, and the pixels
+        are written by code specialized for the pixel format of the screen.
+        Pixels outside of the screen are ignored.
     */
 
     void drawLine(int x1, int y1, int x2, int y2, Uint32 color);
@@ -228,6 +595,15 @@ protected:
         to point (x2, y2).
     */
 
+    void drawLines(const Couple *endPoints, size_t numEndPoints, Uint32 color);
+    /*  Draws numEndPoints / 2 lines of the given color: the first one
+        from endPoints[0] to endPoints[1], the second one from endPoints[2]
+        to endPoints[3], etc.
+        Equivalent to calling drawLine() on each pair of points, but the
+        screen is only locked once and the color ramp of the antialiasing
+        is only looked up once.
+    */
+
     void fillRect(int x, int y, int width, int height, Uint32 color);
     /*  Fills a rectangle with the given color at an upper-left corner
         given by (x, y) and with dimensions given by width and height.
@@ -238,6 +614,41 @@ protected:
         font used by writeString().
     */
 
+    void markDirtyRect(int x, int y, int width, int height) const;
+    /*  Records that the given screen region has been modified and must
+        be presented at the end of the current frame.
+        The region is clipped to the screen and merged with the regions
+        already recorded that it overlaps.
+        Does nothing if the dirty rectangle mode is off.
+    */
+
+    void presentScreen();
+    /*  Makes the drawing done on theSDLScreen visible.
+        Calls SDL_Flip() unless in dirty rectangle mode, in which case
+        SDL_UpdateRects() is called on the regions recorded since the
+        last presentation.
+        Called by run() at the end of every frame.
+    */
+
+    bool processEvents();
+    /*  Processes the pending SDL events by calling processKey()
+        or waitForReactivation(), as appropriate.
+        Returns false if the program must quit, true otherwise.
+        Called by run() and runFixedStep() at the beginning of every frame.
+    */
+
+    void beginFrame();
+    void endFrame();
+    /*  Mark the limits of a frame for the profiler and the telemetry.
+        Called by run(), runFixedStep() and runThreaded().
+    */
+
+    void drawProfilerOverlay();
+    /*  Draws the profiler statistics on the screen.
+        Called before each presentation if setProfilerOverlay(true)
+        has been called.
+    */
+
     bool waitForReactivation();
     /*  Sleeps while waiting for SDL events until a reactivation event
         or a quit event is received.
@@ -249,11 +660,90 @@ protected:
 
 private:
 
-    void putpixel(SDL_Surface *surface, int x, int y, Uint32 pixel);
+    enum { MAX_DIRTY_RECTS = 64 };
+        // above this number of regions, the whole screen is presented
+
+    void addDirtyRect(SDL_Rect r) const;
+
+    void blitSurface(SDL_Surface *src, SDL_Rect *srcrect,
+                     SDL_Surface *dst, SDL_Rect *dstrect) const;
+        // SDL_BlitSurface(), or ColorKeyBlitter if allowed and possible
+    bool cullBlit(const SDL_Surface *surface,
+                  int x, int y, int width, int height) const;
+        // true if the rectangle is outside of the clipping rectangle
+        // of 'surface'; updates the blit counters
+    const SDL_Rect &getCullRect(const SDL_Surface *surface) const;
+        // clipping rectangle of 'surface' as seen by the drawing methods
+    Couple getViewOffset(const SDL_Surface *surface) const;
+        // added to world positions drawn on 'surface' (see setViewport())
+
+    const Viewport *theViewport;  // not owned; NULL if none
+
+    // Input logging (see setInputLog()):
+    bool callTick();
+        // injects the logged input, calls tick() and counts it
+    bool injectLoggedInput();
+        // returns false if the replayed session ends before this tick
+    void dispatchKey(SDLKey key, bool pressed);
+    void dispatchActivation(bool appActive);
+    void recordInputEnd();
+    bool isReplayingInput() const;
+
+    InputLog *inputLog;  // NULL if none
+    Uint32 tickCount;
+
+    // Threaded mode (see runThreaded()):
+    bool isRecordingDraws() const;
+        // true if called on the simulation thread in threaded mode
+    static int simulationThreadMain(void *engine);
+    void simulationLoop();
+    void publishDrawCommands();
+    void playDrawCommands(const DrawCommandBuffer &buffer);
+
+    bool threadedMode;  // true while runThreaded() is running
+    int threadedMillisecondsPerFrame;
+    Uint32 simulationThreadID;
+    DrawCommandBuffer drawBuffers[3];
+    DrawCommandBuffer *simBuffer;  // recorded by the simulation thread
+    DrawCommandBuffer *presentBuffer;  // played back by the main thread
+    SDL_Rect recordedScreenClip;
+        // clipping rectangle of the screen once simBuffer is played back
+    SDL_mutex *threadMutex;  // protects the members below
+    SDL_cond *threadCond;  // signaled when one of them changes
+    DrawCommandBuffer *readyBuffer;  // published, not yet presented
+    bool readyBufferFull;
+    std::vector<std::pair<SDLKey, bool> > pendingKeys;  // for processKey()
+    bool quitRequested;
+    bool pauseRequested;  // app deactivated
+    bool simulationPaused;  // simulation thread waits for end of pause
+    bool simulationFinished;
+
+    void blitStringChars(const char *s, Couple pos, SDL_Surface *surface,
+                         SDL_Surface *fontPixmap, const SDL_Rect &fontRect);
+    SDL_Surface *getCachedString(const char *s, size_t len,
+                                 SDL_Surface *fontPixmap,
+                                 const SDL_Rect &fontRect);
+        // returns NULL if the string cannot be cached
+    void evictStrings(size_t budget);
     void initWuLineAlgorithm();
-    void wu_line(SDL_Surface *surface,
-                Uint32 x0, Uint32 y0, Uint32 x1, Uint32 y1,
-                Uint32 fgc, Uint32 bgc);
+    const Uint32 *getWuColorRamp(SDL_Surface *surface, Uint32 fgc, Uint32 bgc);
+
+    struct PixelWriters
+    {
+        void (*pixel)(SDL_Surface *surface, int x, int y, Uint32 pixel);
+        void (*span)(SDL_Surface *surface, int x, int y, int width, Uint32 pixel);
+        void (*line)(SDL_Surface *surface,
+                     Uint32 x0, Uint32 y0, Uint32 x1, Uint32 y1,
+                     Uint32 fgc, const Uint32 *colors);
+            // Wu's algorithm; 'colors' must come from getWuColorRamp()
+    };
+    /*  Functions that write to a locked surface with a given number
+        of bytes per pixel, without testing the pixel format.
+    */
+
+    static PixelWriters getPixelWriters(int bytesPerPixel);
+
+    PixelWriters theWriters;  // for theSDLScreen; set by setVideoMode()
 
     /*  Forbidden operations:
     */
@@ -262,6 +752,22 @@ private:
 };
 
 
+inline
+Uint32
+GameEngine::getTickCount() const
+{
+    return tickCount;
+}
+
+
+inline
+bool
+GameEngine::isHeadless() const
+{
+    return headless;
+}
+
+
 inline
 bool
 GameEngine::inFullScreenMode() const
@@ -270,6 +776,165 @@ GameEngine::inFullScreenMode() const
 }
 
 
+inline
+JobSystem &
+GameEngine::getJobSystem()
+{
+    return theJobSystem;
+}
+
+
+inline
+FrameProfiler &
+GameEngine::getProfiler()
+{
+    return theProfiler;
+}
+
+
+inline
+TelemetryRecorder &
+GameEngine::getTelemetry()
+{
+    return theTelemetry;
+}
+
+
+inline
+const FramePacer &
+GameEngine::getFramePacer() const
+{
+    return thePacer;
+}
+
+
+inline
+bool
+GameEngine::inDirtyRectMode() const
+{
+    return usingDirtyRects;
+}
+
+
+inline
+void
+GameEngine::setNativeBlits(bool enable)
+{
+    nativeBlits = enable;
+}
+
+
+inline
+bool
+GameEngine::usingNativeBlits() const
+{
+    return nativeBlits;
+}
+
+
+inline
+const Viewport *
+GameEngine::getViewport() const
+{
+    return theViewport;
+}
+
+
+inline
+unsigned long
+GameEngine::getNumBlitsDrawn() const
+{
+    return numBlitsDrawn;
+}
+
+
+inline
+unsigned long
+GameEngine::getNumBlitsCulled() const
+{
+    return numBlitsCulled;
+}
+
+
+inline
+bool
+GameEngine::cullBlit(const SDL_Surface *surface,
+                     int x, int y, int width, int height) const
+{
+    // In int, so that far away positions do not wrap around like Sint16.
+    const SDL_Rect &clip = getCullRect(surface);
+    if (x >= clip.x + clip.w || x + width <= clip.x
+            || y >= clip.y + clip.h || y + height <= clip.y)
+    {
+        numBlitsCulled++;
+        return true;
+    }
+    numBlitsDrawn++;
+    return false;
+}
+
+
+inline
+const SDL_Rect &
+GameEngine::getCullRect(const SDL_Surface *surface) const
+{
+    // The simulation thread must not read the clipping rectangle
+    // that the presentation thread sets while playing back.
+    if (surface == theSDLScreen && isRecordingDraws())
+        return recordedScreenClip;
+    return surface->clip_rect;
+}
+
+
+inline
+Couple
+GameEngine::getViewOffset(const SDL_Surface *surface) const
+{
+    // With runThreaded(), the positions are translated when recorded;
+    // the presentation thread plays back screen positions.
+    if (surface != theSDLScreen || (threadedMode && !isRecordingDraws())
+            || theViewport == NULL)
+        return Couple();
+    return theViewport->getOffset();
+}
+
+
+inline
+void
+GameEngine::blitSurface(SDL_Surface *src, SDL_Rect *srcrect,
+                        SDL_Surface *dst, SDL_Rect *dstrect) const
+{
+    int width = (srcrect != NULL ? srcrect->w : src->w);
+    if (!nativeBlits || width > ColorKeyBlitter::MAX_SPRITE_WIDTH
+            || !ColorKeyBlitter::blit(src, srcrect, dst, dstrect))
+        SDL_BlitSurface(src, srcrect, dst, dstrect);
+}
+
+
+inline
+bool
+GameEngine::isRecordingDraws() const
+{
+    return threadedMode && SDL_ThreadID() == simulationThreadID;
+}
+
+
+inline
+size_t
+GameEngine::getStringCacheBudget() const
+{
+    return stringCacheBudget;
+}
+
+
+inline
+size_t
+GameEngine::getStringCacheSize() const
+{
+    return stringCacheSize;
+}
+
+
 inline
 int
 GameEngine::getScreenWidthInPixels() const
@@ -293,8 +958,51 @@ GameEngine::copyPixmap(SDL_Surface *src, Couple dest,
 {
     if (surface == NULL)
         surface = theSDLScreen;
+    dest += getViewOffset(surface);
+    if (cullBlit(surface, dest.x, dest.y, src->w, src->h))
+        return;
+    ProfileScope scope(theProfiler, FrameProfiler::BLIT);
+    if (surface == theSDLScreen && isRecordingDraws())
+    {
+        simBuffer->addBlit(src, NULL, dest.x, dest.y);
+        return;
+    }
+    SDL_Rect dstrect = { Sint16(dest.x), Sint16(dest.y), 0, 0 };
+    blitSurface(src, NULL, surface, &dstrect);
+    if (surface == theSDLScreen)
+    {
+        numScreenBlits++;
+        if (usingDirtyRects)
+            addDirtyRect(dstrect);  // blitSurface() left the clipped rectangle
+    }
+}
+
+
+inline
+void
+GameEngine::copyPixmap(const PixmapArray &pa, size_t pixmapNo, Couple dest,
+                                SDL_Surface *surface) const
+{
+    if (surface == NULL)
+        surface = theSDLScreen;
+    SDL_Rect srcrect = pa.getImageRect(pixmapNo);
+    dest += getViewOffset(surface);
+    if (cullBlit(surface, dest.x, dest.y, srcrect.w, srcrect.h))
+        return;
+    ProfileScope scope(theProfiler, FrameProfiler::BLIT);
+    if (surface == theSDLScreen && isRecordingDraws())
+    {
+        simBuffer->addBlit(pa.getImage(pixmapNo), &srcrect, dest.x, dest.y);
+        return;
+    }
     SDL_Rect dstrect = { Sint16(dest.x), Sint16(dest.y), 0, 0 };
-    SDL_BlitSurface(src, NULL, surface, &dstrect);
+    blitSurface(pa.getImage(pixmapNo), &srcrect, surface, &dstrect);
+    if (surface == theSDLScreen)
+    {
+        numScreenBlits++;
+        if (usingDirtyRects)
+            addDirtyRect(dstrect);
+    }
 }
 
 
@@ -305,13 +1013,29 @@ GameEngine::copySpritePixmap(const Sprite &s, size_t pixmapNo,
 {
     if (surface == NULL)
         surface = theSDLScreen;
+    SDL_Rect srcrect = s.getPixmapArray()->getImageRect(pixmapNo);
+    posInSurface += getViewOffset(surface);
+    if (cullBlit(surface, posInSurface.x, posInSurface.y, srcrect.w, srcrect.h))
+        return;
+    ProfileScope scope(theProfiler, FrameProfiler::BLIT);
     SDL_Surface *image = s.getPixmap(pixmapNo);
+    if (surface == theSDLScreen && isRecordingDraws())
+    {
+        simBuffer->addBlit(image, &srcrect, posInSurface.x, posInSurface.y);
+        return;
+    }
     SDL_Rect dstrect = { Sint16(posInSurface.x), Sint16(posInSurface.y), 0, 0 };
-    SDL_BlitSurface(image, NULL, surface, &dstrect);
+    blitSurface(image, &srcrect, surface, &dstrect);
         /*  We suppose that the image has a color key that indicates
             which pixel is of the transparent color.
             See SDL doc re: SDL_SetColorKey().
         */
+    if (surface == theSDLScreen)
+    {
+        numScreenBlits++;
+        if (usingDirtyRects)
+            addDirtyRect(dstrect);
+    }
 }
 
 
@@ -322,14 +1046,60 @@ GameEngine::copySpritePixmap(const RSprite &s, size_t pixmapNo,
 {
     if (surface == NULL)
         surface = theSDLScreen;
+    SDL_Rect srcrect = s.getPixmapArray()->getImageRect(pixmapNo);
+    Couple p = posInSurface.round() + getViewOffset(surface);
+    if (cullBlit(surface, p.x, p.y, srcrect.w, srcrect.h))
+        return;
+    ProfileScope scope(theProfiler, FrameProfiler::BLIT);
     SDL_Surface *image = s.getPixmap(pixmapNo);
-    Couple p = posInSurface.round();
+    if (surface == theSDLScreen && isRecordingDraws())
+    {
+        simBuffer->addBlit(image, &srcrect, p.x, p.y);
+        return;
+    }
     SDL_Rect dstrect = { Sint16(p.x), Sint16(p.y), 0, 0 };
-    SDL_BlitSurface(image, NULL, surface, &dstrect);
+    blitSurface(image, &srcrect, surface, &dstrect);
         /*  We suppose that the image has a color key that indicates
             which pixel is of the transparent color.
             See SDL doc re: SDL_SetColorKey().
         */
+    if (surface == theSDLScreen)
+    {
+        numScreenBlits++;
+        if (usingDirtyRects)
+            addDirtyRect(dstrect);
+    }
+}
+
+
+inline
+void
+GameEngine::submitPixmap(const PixmapArray &pa, size_t pixmapNo, Couple dest,
+                         int layer)
+{
+    const SDL_Rect &srcrect = pa.getImageRect(pixmapNo);
+    dest += getViewOffset(theSDLScreen);
+    if (!cullBlit(theSDLScreen, dest.x, dest.y, srcrect.w, srcrect.h))
+        theDrawList.add(pa.getImage(pixmapNo), srcrect, dest.x, dest.y,
+                        getCullRect(theSDLScreen), layer);
+}
+
+
+inline
+void
+GameEngine::submitSprite(const Sprite &s, size_t pixmapNo,
+                         Couple posInSurface, int layer)
+{
+    submitPixmap(*s.getPixmapArray(), pixmapNo, posInSurface, layer);
+}
+
+
+inline
+void
+GameEngine::submitSprite(const RSprite &s, size_t pixmapNo,
+                         RCouple posInSurface, int layer)
+{
+    submitPixmap(*s.getPixmapArray(), pixmapNo, posInSurface.round(), layer);
 }
 
 
@@ -393,7 +1163,8 @@ inline
 void
 GameEngine::drawPixel(int x, int y, Uint32 color)
 {
-    putpixel(theSDLScreen, x, y, color);
+    Couple point(x, y);
+    drawPixels(&point, 1, color);
 }
 
 
@@ -401,7 +1172,8 @@ inline
 void
 GameEngine::drawLine(int x1, int y1, int x2, int y2, Uint32 color)
 {
-    wu_line(theSDLScreen, Uint32(x1), Uint32(y1), Uint32(x2), Uint32(y2), color, 0);
+    Couple endPoints[2] = { Couple(x1, y1), Couple(x2, y2) };
+    drawLines(endPoints, 2, color);
 }
 
 
@@ -409,8 +1181,28 @@ inline
 void
 GameEngine::fillRect(int x, int y, int width, int height, Uint32 color)
 {
-    SDL_Rect rect = { x, y, width, height };
+    Couple offset = getViewOffset(theSDLScreen);
+    x += offset.x;
+    y += offset.y;
+    if (isRecordingDraws())
+    {
+        simBuffer->addFillRect(x, y, width, height, color);
+        return;
+    }
+
+    // Clip in int, so that far away rectangles do not wrap around like Sint16.
+    const SDL_Rect &clip = theSDLScreen->clip_rect;
+    int right = std::min(x + width, clip.x + clip.w);
+    int bottom = std::min(y + height, clip.y + clip.h);
+    x = std::max(x, int(clip.x));
+    y = std::max(y, int(clip.y));
+    if (x >= right || y >= bottom)
+        return;
+
+    SDL_Rect rect = { Sint16(x), Sint16(y), Uint16(right - x), Uint16(bottom - y) };
     (void) SDL_FillRect(theSDLScreen, &rect, color);
+    if (usingDirtyRects)
+        addDirtyRect(rect);  // SDL_FillRect() left the clipped rectangle
 }
 
 
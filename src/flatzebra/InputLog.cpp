@@ -0,0 +1,407 @@
+/*  $Id$
+    InputLog.cpp - Recording and replay of the input events of a game.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/InputLog.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+/*  Format: the file header, then one record per event:
+        - tick number, minus that of the previous record (varint);
+        - type byte: EventType in bits 0-1, 'pressed' in bit 7;
+        - KEY: key symbol (varint);
+          JOYSTICK: number of buttons (varint), button bits (LSB first),
+          then each axis as a little-endian 16-bit value.
+    A varint is 7 bits per byte, least significant first, with bit 7
+    set on every byte except the last.
+*/
+static const char fileMagic[] = "FZIL";
+static const Uint8 fileVersion = 1;
+static const Uint8 PRESSED_BIT = 0x80;
+
+
+InputLog::InputLog()
+  : mode(IDLE),
+    currentTick(0),
+    data(),
+    lastTick(0),
+    readPos(0),
+    joystickButtons(),
+    joystickAxes()
+{
+    memset(joystickAxes, 0, sizeof(joystickAxes));
+}
+
+
+void
+InputLog::startRecording()
+{
+    mode = RECORDING;
+    data.clear();
+    currentTick = 0;
+    lastTick = 0;
+    joystickButtons.clear();
+    memset(joystickAxes, 0, sizeof(joystickAxes));
+}
+
+
+void
+InputLog::startReplay()
+{
+    mode = REPLAYING;
+    currentTick = 0;
+    lastTick = 0;
+    readPos = 0;
+    joystickButtons.clear();
+    memset(joystickAxes, 0, sizeof(joystickAxes));
+}
+
+
+void
+InputLog::stop()
+{
+    mode = IDLE;
+}
+
+
+bool
+InputLog::save(const string &fileName) const
+{
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if (file == NULL)
+        return false;
+    bool ok = (fwrite(fileMagic, 1, 4, file) == 4
+               && fwrite(&fileVersion, 1, 1, file) == 1
+               && (data.empty()
+                   || fwrite(&data[0], 1, data.size(), file) == data.size()));
+    if (fclose(file) != 0)
+        ok = false;
+    return ok;
+}
+
+
+bool
+InputLog::load(const string &fileName)
+{
+    mode = IDLE;
+    data.clear();
+
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (file == NULL)
+        return false;
+
+    char magic[4];
+    Uint8 version = 0;
+    bool ok = (fread(magic, 1, 4, file) == 4
+               && memcmp(magic, fileMagic, 4) == 0
+               && fread(&version, 1, 1, file) == 1
+               && version == fileVersion);
+    Uint8 buffer[4096];
+    size_t n;
+    while (ok && (n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+    if (ferror(file))
+        ok = false;
+    fclose(file);
+
+    if (!ok)
+        data.clear();
+    return ok;
+}
+
+
+void
+InputLog::setTick(Uint32 tick)
+{
+    currentTick = tick;
+}
+
+
+void
+InputLog::putByte(Uint8 b)
+{
+    data.push_back(b);
+}
+
+
+void
+InputLog::putVarUint(Uint32 n)
+{
+    while (n >= 0x80)
+    {
+        putByte(Uint8(n | 0x80));
+        n >>= 7;
+    }
+    putByte(Uint8(n));
+}
+
+
+bool
+InputLog::getByte(Uint8 &b)
+{
+    if (readPos >= data.size())
+        return false;
+    b = data[readPos++];
+    return true;
+}
+
+
+bool
+InputLog::getVarUint(Uint32 &n)
+{
+    n = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        Uint8 b;
+        if (!getByte(b))
+            return false;
+        n |= Uint32(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+
+void
+InputLog::putTickAndType(EventType type)
+{
+    assert(currentTick >= lastTick);
+    putVarUint(currentTick - lastTick);
+    lastTick = currentTick;
+    putByte(Uint8(type));
+}
+
+
+void
+InputLog::recordKey(SDLKey key, bool pressed)
+{
+    if (mode != RECORDING)
+        return;
+    putTickAndType(KEY);
+    if (pressed)
+        data.back() |= PRESSED_BIT;
+    putVarUint(Uint32(key));
+}
+
+
+void
+InputLog::recordActivation(bool active)
+{
+    if (mode != RECORDING)
+        return;
+    putTickAndType(ACTIVATION);
+    if (active)
+        data.back() |= PRESSED_BIT;
+}
+
+
+void
+InputLog::recordEnd()
+{
+    if (mode != RECORDING)
+        return;
+    putTickAndType(END);
+}
+
+
+void
+InputLog::recordJoystick(const vector<bool> &buttons,
+                         const Sint16 axes[NUM_JOYSTICK_AXES])
+{
+    if (mode != RECORDING)
+        return;
+    if (buttons == joystickButtons
+            && memcmp(axes, joystickAxes, sizeof(joystickAxes)) == 0)
+        return;
+    joystickButtons = buttons;
+    memcpy(joystickAxes, axes, sizeof(joystickAxes));
+
+    putTickAndType(JOYSTICK);
+    putVarUint(Uint32(buttons.size()));
+    for (size_t i = 0; i < buttons.size(); i += 8)
+    {
+        Uint8 bits = 0;
+        for (size_t j = 0; j < 8 && i + j < buttons.size(); j++)
+            if (buttons[i + j])
+                bits |= Uint8(1 << j);
+        putByte(bits);
+    }
+    for (size_t i = 0; i < NUM_JOYSTICK_AXES; i++)
+    {
+        Uint16 a = Uint16(axes[i]);
+        putByte(Uint8(a & 0xFF));
+        putByte(Uint8(a >> 8));
+    }
+}
+
+
+bool
+InputLog::peekTick(Uint32 &tick)
+{
+    size_t pos = readPos;
+    Uint32 delta;
+    bool ok = getVarUint(delta);
+    readPos = pos;
+    tick = lastTick + delta;
+    return ok;
+}
+
+
+bool
+InputLog::readEvent(Event &event)
+{
+    Uint32 delta;
+    Uint8 typeByte;
+    if (!getVarUint(delta) || !getByte(typeByte))
+        return false;
+    lastTick += delta;
+
+    event.tick = lastTick;
+    event.type = EventType(typeByte & 0x03);
+    event.key = SDLK_UNKNOWN;
+    event.pressed = ((typeByte & PRESSED_BIT) != 0);
+
+    switch (event.type)
+    {
+        case KEY:
+        {
+            Uint32 key;
+            if (!getVarUint(key))
+                return false;
+            event.key = SDLKey(key);
+            return true;
+        }
+
+        case JOYSTICK:
+        {
+            Uint32 numButtons;
+            if (!getVarUint(numButtons) || numButtons > 8 * (data.size() - readPos))
+                return false;
+            joystickButtons.assign(numButtons, false);
+            for (size_t i = 0; i < numButtons; i += 8)
+            {
+                Uint8 bits;
+                if (!getByte(bits))
+                    return false;
+                for (size_t j = 0; j < 8 && i + j < numButtons; j++)
+                    joystickButtons[i + j] = ((bits >> j) & 1) != 0;
+            }
+            for (size_t i = 0; i < NUM_JOYSTICK_AXES; i++)
+            {
+                Uint8 lo, hi;
+                if (!getByte(lo) || !getByte(hi))
+                    return false;
+                joystickAxes[i] = Sint16(Uint16(lo | (hi << 8)));
+            }
+            return true;
+        }
+
+        case ACTIVATION:
+        case END:
+            return true;
+    }
+    return false;
+}
+
+
+bool
+InputLog::peekType(EventType &type)
+{
+    size_t pos = readPos;
+    Uint32 delta;
+    Uint8 typeByte;
+    bool ok = getVarUint(delta) && getByte(typeByte);
+    readPos = pos;
+    if (ok)
+        type = EventType(typeByte & 0x03);
+    return ok;
+}
+
+
+bool
+InputLog::getNextEvent(Event &event)
+{
+    if (mode != REPLAYING)
+        return false;
+
+    Uint32 tick;
+    while (peekTick(tick) && tick <= currentTick)
+    {
+        if (!readEvent(event))
+        {
+            readPos = data.size();  // truncated log: end the replay
+            return false;
+        }
+        if (event.type != JOYSTICK)  // joystick states are not returned
+            return true;
+    }
+    return false;
+}
+
+
+bool
+InputLog::isReplayFinished() const
+{
+    return mode == REPLAYING && readPos >= data.size();
+}
+
+
+void
+InputLog::consumeJoystickEvents()
+{
+    // Stop at any other kind of event, which is for getNextEvent().
+    Uint32 tick;
+    EventType type;
+    Event event;
+    while (peekTick(tick) && tick <= currentTick
+            && peekType(type) && type == JOYSTICK)
+        if (!readEvent(event))
+        {
+            readPos = data.size();
+            break;
+        }
+}
+
+
+const vector<bool> &
+InputLog::getJoystickButtons()
+{
+    if (mode == REPLAYING)
+        consumeJoystickEvents();
+    return joystickButtons;
+}
+
+
+const Sint16 *
+InputLog::getJoystickAxes()
+{
+    if (mode == REPLAYING)
+        consumeJoystickEvents();
+    return joystickAxes;
+}
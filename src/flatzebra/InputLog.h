@@ -0,0 +1,184 @@
+/*  $Id$
+    InputLog.h - Recording and replay of the input events of a game.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_InputLog
+#define _H_InputLog
+
+#include <SDL.h>
+#include <SDL_keysym.h>
+
+#include <string>
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class InputLog
+/*  Log of the input events received by a game, indexed by tick number,
+    so that a session can be replayed exactly, e.g., to compare the
+    performance of two builds on the same workload.
+
+    In recording mode, GameEngine appends the key and activation events
+    that it passes to the game, and a Joystick attached to the log
+    appends its state whenever it changes.
+    In replay mode, GameEngine ignores the live keyboard and injects
+    the logged events before the same tick numbers, and the attached
+    Joystick returns the logged state.
+
+    The log is kept in memory in a compact binary form (about 3 bytes
+    per key event) and can be saved to and loaded from a file.
+*/
+{
+public:
+
+    enum Mode { IDLE, RECORDING, REPLAYING };
+
+    enum EventType
+    {
+        KEY,         // 'key' and 'pressed' are valid
+        ACTIVATION,  // 'pressed' is the new activation state
+        JOYSTICK,    // new joystick state, see getJoystickButtons()
+        END          // the recorded session ended here
+    };
+
+    struct Event
+    {
+        Uint32 tick;
+        EventType type;
+        SDLKey key;
+        bool pressed;
+    };
+
+    enum { NUM_JOYSTICK_AXES = 6 };
+
+    InputLog();
+
+    Mode getMode() const;
+
+    void startRecording();
+    /*  Empties the log and enters recording mode at tick zero.
+    */
+
+    void startReplay();
+    /*  Enters replay mode at the beginning of the log, at tick zero.
+    */
+
+    void stop();
+    /*  Enters idle mode. The log is kept.
+    */
+
+    bool save(const std::string &fileName) const;
+    bool load(const std::string &fileName);
+    /*  Write or read the log to or from a file.
+        load() enters idle mode.
+        Return false upon an I/O error or an invalid file.
+    */
+
+    void setTick(Uint32 tick);
+    Uint32 getTick() const;
+    /*  Current tick number, used to timestamp the recorded events and
+        to select the replayed events. Set by GameEngine.
+    */
+
+    void recordKey(SDLKey key, bool pressed);
+    void recordActivation(bool active);
+    void recordEnd();
+    void recordJoystick(const std::vector<bool> &buttons,
+                        const Sint16 axes[NUM_JOYSTICK_AXES]);
+    /*  Append an event at the current tick. Do nothing unless recording.
+        recordJoystick() only appends if the state differs from the
+        last recorded one.
+    */
+
+    bool getNextEvent(Event &event);
+    /*  In replay mode, returns the next logged event whose tick is at
+        most the current tick, and returns true.
+        Returns false if there is no such event.
+        JOYSTICK events are not returned: they update the state returned
+        by getJoystickButtons() and getJoystickAxes().
+    */
+
+    bool isReplayFinished() const;
+    /*  True in replay mode when all the events have been returned.
+    */
+
+    const std::vector<bool> &getJoystickButtons();
+    const Sint16 *getJoystickAxes();
+    /*  In replay mode, the joystick state logged at or before the current
+        tick (all released and centered before the first such event).
+    */
+
+    size_t getSizeInBytes() const;
+
+private:
+
+    void putByte(Uint8 b);
+    void putVarUint(Uint32 n);
+    bool getByte(Uint8 &b);
+    bool getVarUint(Uint32 &n);
+    void putTickAndType(EventType type);
+    bool peekTick(Uint32 &tick);
+    bool peekType(EventType &type);
+    bool readEvent(Event &event);
+        // reads one record; updates the joystick state if it is one
+    void consumeJoystickEvents();
+
+    Mode mode;
+    Uint32 currentTick;
+    std::vector<Uint8> data;
+    Uint32 lastTick;  // of the last event written or read
+    size_t readPos;  // in 'data', when replaying
+    std::vector<bool> joystickButtons;
+    Sint16 joystickAxes[NUM_JOYSTICK_AXES];
+};
+
+
+inline
+InputLog::Mode
+InputLog::getMode() const
+{
+    return mode;
+}
+
+
+inline
+Uint32
+InputLog::getTick() const
+{
+    return currentTick;
+}
+
+
+inline
+size_t
+InputLog::getSizeInBytes() const
+{
+    return data.size();
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_InputLog */
@@ -0,0 +1,314 @@
+/*  $Id$
+    JobSystem.cpp - Work-stealing scheduler of jobs on worker threads.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/JobSystem.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Job
+//
+
+
+Job::Job()
+  : numPendingDependencies(0),
+    dependents(),
+    submitted(false),
+    done(false)
+{
+}
+
+
+/*virtual*/
+Job::~Job()
+{
+}
+
+
+bool
+Job::isDone() const
+{
+    return done;
+}
+
+
+void
+Job::reset()
+{
+    assert(!submitted || done);
+    numPendingDependencies = 0;
+    dependents.clear();
+    submitted = false;
+    done = false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// JobSystem
+//
+
+
+JobSystem::JobSystem(size_t numWorkers)
+  : workers(),
+    queues(numWorkers + 1),
+    globalMutex(SDL_CreateMutex()),
+    jobReady(SDL_CreateCond()),
+    jobDone(SDL_CreateCond()),
+    numQueuedJobs(0),
+    stopping(false)
+{
+    for (size_t i = 0; i < queues.size(); i++)
+        queues[i].mutex = SDL_CreateMutex();
+
+    if (globalMutex == NULL || jobReady == NULL || jobDone == NULL)
+        return;  // no workers: wait() executes the jobs
+
+    /*  Reserve the workers first, because each thread receives a pointer
+        to its element of 'workers'.
+    */
+    workers.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; i++)
+    {
+        Worker w = { this, i, NULL };
+        workers.push_back(w);
+        workers.back().thread = SDL_CreateThread(workerMain, &workers.back());
+        if (workers.back().thread == NULL)
+        {
+            workers.pop_back();
+            break;
+        }
+    }
+}
+
+
+JobSystem::~JobSystem()
+{
+    if (globalMutex != NULL)
+    {
+        SDL_LockMutex(globalMutex);
+        stopping = true;
+        SDL_CondBroadcast(jobReady);
+        SDL_UnlockMutex(globalMutex);
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        SDL_WaitThread(workers[i].thread, NULL);
+
+    for (size_t i = 0; i < queues.size(); i++)
+        SDL_DestroyMutex(queues[i].mutex);
+    SDL_DestroyCond(jobDone);
+    SDL_DestroyCond(jobReady);
+    SDL_DestroyMutex(globalMutex);
+}
+
+
+/*static*/
+size_t
+JobSystem::getNumProcessors()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long n = long(info.dwNumberOfProcessors);
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    long n = 1;
+#endif
+    return n > 0 ? size_t(n) : 1;
+}
+
+
+/*static*/
+int
+JobSystem::workerMain(void *worker)
+{
+    Worker *w = static_cast<Worker *>(worker);
+    w->system->workerLoop(w->index);
+    return 0;
+}
+
+
+void
+JobSystem::workerLoop(size_t index)
+{
+    for (;;)
+    {
+        SDL_LockMutex(globalMutex);
+        while (numQueuedJobs == 0 && !stopping)
+            SDL_CondWait(jobReady, globalMutex);
+        bool stop = stopping;
+        SDL_UnlockMutex(globalMutex);
+
+        if (stop)
+            return;
+
+        (void) runOneJob(index);
+    }
+}
+
+
+size_t
+JobSystem::getCurrentQueue() const
+{
+    Uint32 id = SDL_ThreadID();
+    for (size_t i = 0; i < workers.size(); i++)
+        if (SDL_GetThreadID(workers[i].thread) == id)
+            return i;
+    return queues.size() - 1;  // not a worker thread
+}
+
+
+bool
+JobSystem::runOneJob(size_t index)
+{
+    Job *job = NULL;
+
+    // Take the newest job of our own queue, which is likely to be
+    // related to the job that this thread just executed.
+    Queue &own = queues[index];
+    SDL_LockMutex(own.mutex);
+    if (!own.jobs.empty())
+    {
+        job = own.jobs.back();
+        own.jobs.pop_back();
+    }
+    SDL_UnlockMutex(own.mutex);
+
+    // Otherwise, steal the oldest job of another queue.
+    for (size_t k = 1; job == NULL && k < queues.size(); k++)
+    {
+        Queue &victim = queues[(index + k) % queues.size()];
+        SDL_LockMutex(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+        }
+        SDL_UnlockMutex(victim.mutex);
+    }
+
+    if (job == NULL)
+        return false;
+
+    SDL_LockMutex(globalMutex);
+    assert(numQueuedJobs > 0);
+    numQueuedJobs--;
+    SDL_UnlockMutex(globalMutex);
+
+    job->execute();
+    finish(*job);
+    return true;
+}
+
+
+void
+JobSystem::enqueue(Job &job)
+{
+    Queue &q = queues[getCurrentQueue()];
+    SDL_LockMutex(q.mutex);
+    q.jobs.push_back(&job);
+    SDL_UnlockMutex(q.mutex);
+    numQueuedJobs++;
+    SDL_CondSignal(jobReady);
+}
+
+
+void
+JobSystem::finish(Job &job)
+{
+    SDL_LockMutex(globalMutex);
+    job.done = true;
+    for (vector<Job *>::iterator it = job.dependents.begin();
+                                it != job.dependents.end(); ++it)
+    {
+        Job &dependent = **it;
+        assert(dependent.numPendingDependencies > 0);
+        if (--dependent.numPendingDependencies == 0 && dependent.submitted)
+            enqueue(dependent);
+    }
+    SDL_CondBroadcast(jobDone);
+    SDL_UnlockMutex(globalMutex);
+}
+
+
+void
+JobSystem::addDependency(Job &job, Job &prerequisite)
+{
+    SDL_LockMutex(globalMutex);
+    assert(!job.submitted);
+    if (!prerequisite.done)
+    {
+        job.numPendingDependencies++;
+        prerequisite.dependents.push_back(&job);
+    }
+    SDL_UnlockMutex(globalMutex);
+}
+
+
+void
+JobSystem::submit(Job &job)
+{
+    SDL_LockMutex(globalMutex);
+    assert(!job.submitted);
+    job.submitted = true;
+    if (job.numPendingDependencies == 0)
+        enqueue(job);
+    SDL_UnlockMutex(globalMutex);
+}
+
+
+void
+JobSystem::wait(Job &job)
+{
+    size_t index = getCurrentQueue();
+    for (;;)
+    {
+        SDL_LockMutex(globalMutex);
+        bool done = job.done;
+        SDL_UnlockMutex(globalMutex);
+        if (done)
+            return;
+
+        if (runOneJob(index))
+            continue;
+
+        // Nothing to help with: sleep until some job is done.
+        SDL_LockMutex(globalMutex);
+        if (!job.done)
+            SDL_CondWaitTimeout(jobDone, globalMutex, 1);
+        SDL_UnlockMutex(globalMutex);
+    }
+}
@@ -0,0 +1,268 @@
+/*  $Id$
+    JobSystem.h - Work-stealing scheduler of jobs on worker threads.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_JobSystem
+#define _H_JobSystem
+
+#include <SDL.h>
+
+#include <vector>
+#include <deque>
+
+
+namespace flatzebra {
+
+
+class JobSystem;
+
+
+class Job
+/*  Unit of work executed by a JobSystem.
+    Derive from this class and implement execute().
+    The object is owned by the caller, and it must remain valid until
+    JobSystem::wait() has returned for it.
+*/
+{
+public:
+
+    Job();
+    virtual ~Job();
+
+    virtual void execute() = 0;
+    /*  Does the work. Called once, on any thread of the JobSystem
+        (including a thread that waits in JobSystem::wait()).
+    */
+
+    bool isDone() const;
+    /*  Indicates if execute() has returned.
+        Only reliable on a thread that has called JobSystem::wait()
+        on this job.
+    */
+
+    void reset();
+    /*  Makes this job submittable again, without dependencies.
+        Must not be called while the job is submitted and not done.
+    */
+
+private:
+
+    friend class JobSystem;
+
+    size_t numPendingDependencies;  // prerequisites not done yet
+    std::vector<Job *> dependents;  // jobs waiting for this one
+    bool submitted;
+    bool done;
+
+    /*  Forbidden operations:
+    */
+    Job(const Job &);
+    Job &operator = (const Job &);
+};
+
+
+class JobSystem
+/*  Scheduler that executes jobs on a fixed set of worker threads.
+
+    Each worker thread has its own deque of ready jobs. A worker takes
+    the most recently queued job of its own deque; when that deque is
+    empty, it steals the oldest job of another deque. Workers sleep
+    when no job is ready.
+
+    A job can depend on other jobs: it is only queued once all of its
+    prerequisites are done.
+
+    A thread that calls wait() executes ready jobs while it waits, so
+    a JobSystem with zero workers still works, serially.
+*/
+{
+public:
+
+    JobSystem(size_t numWorkers);
+    /*  Starts 'numWorkers' worker threads.
+        Fewer threads are started if thread creation fails.
+    */
+
+    ~JobSystem();
+    /*  Stops the worker threads.
+        The jobs that are still queued are not executed.
+    */
+
+    size_t getNumWorkers() const;
+    /*  Returns the number of worker threads actually started.
+    */
+
+    static size_t getNumProcessors();
+    /*  Returns the number of processors available to this process,
+        or 1 if it cannot be determined.
+    */
+
+    void addDependency(Job &job, Job &prerequisite);
+    /*  Specifies that 'job' must not be executed before 'prerequisite'
+        is done.
+        Must be called before 'job' is submitted.
+    */
+
+    void submit(Job &job);
+    /*  Queues 'job' for execution, or records that it must be queued
+        when its last prerequisite is done.
+        'job' must not be submitted again before it is done and reset.
+    */
+
+    void wait(Job &job);
+    /*  Returns when 'job' is done. Executes ready jobs in the meantime.
+        'job' must have been submitted.
+    */
+
+    template <class Function>
+    void parallelFor(size_t begin, size_t end, size_t grainSize,
+                     Function &f);
+    /*  Calls f(first, last) on subranges [first, last) that together
+        cover [begin, end), in parallel. Each subrange has at most
+        'grainSize' elements (which must be positive).
+        Returns when all calls have returned.
+        'f' may be called concurrently from several threads.
+    */
+
+    template <class SpriteType, class Function>
+    void parallelForEach(std::vector<SpriteType *> &sprites,
+                         size_t grainSize, Function &f);
+    /*  Calls f(*sprites[i]) for each element of 'sprites', in parallel.
+        Meant for SpriteList and RSpriteList.
+        Returns when all calls have returned.
+    */
+
+private:
+
+    struct Worker
+    {
+        JobSystem *system;
+        size_t index;  // in 'queues'
+        SDL_Thread *thread;
+    };
+
+    template <class Function>
+    class RangeJob : public Job
+    {
+    public:
+        RangeJob() : f(NULL), first(0), last(0) {}
+        virtual void execute() { (*f)(first, last); }
+        Function *f;
+        size_t first, last;
+    };
+
+    template <class SpriteType, class Function>
+    class ForEachFunction
+    {
+    public:
+        ForEachFunction(std::vector<SpriteType *> &s, Function &_f)
+          : sprites(s), f(_f) {}
+        void operator () (size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+                f(*sprites[i]);
+        }
+    private:
+        std::vector<SpriteType *> &sprites;
+        Function &f;
+    };
+
+    static int workerMain(void *worker);
+    void workerLoop(size_t index);
+    bool runOneJob(size_t index);
+        // returns false if no job was ready
+    size_t getCurrentQueue() const;
+    void enqueue(Job &job);  // 'globalMutex' must be locked
+    void finish(Job &job);
+
+    struct Queue
+    {
+        SDL_mutex *mutex;
+        std::deque<Job *> jobs;
+    };
+
+    std::vector<Worker> workers;
+    std::vector<Queue> queues;  // one per worker, plus one for other threads
+    SDL_mutex *globalMutex;  // protects the members below and the Job fields
+    SDL_cond *jobReady;  // signaled when a job is queued
+    SDL_cond *jobDone;  // signaled when a job is done
+    size_t numQueuedJobs;
+    bool stopping;
+
+    /*  Forbidden operations:
+    */
+    JobSystem(const JobSystem &);
+    JobSystem &operator = (const JobSystem &);
+};
+
+
+inline
+size_t
+JobSystem::getNumWorkers() const
+{
+    return workers.size();
+}
+
+
+template <class Function>
+void
+JobSystem::parallelFor(size_t begin, size_t end, size_t grainSize,
+                       Function &f)
+{
+    if (begin >= end)
+        return;
+    size_t numJobs = (end - begin + grainSize - 1) / grainSize;
+    if (numJobs == 1 || workers.empty())
+    {
+        f(begin, end);
+        return;
+    }
+
+    RangeJob<Function> *jobs = new RangeJob<Function>[numJobs];  // Job is not copyable
+    for (size_t i = 0; i < numJobs; i++)
+    {
+        RangeJob<Function> &job = jobs[i];
+        job.f = &f;
+        job.first = begin + i * grainSize;
+        job.last = (i + 1 == numJobs ? end : job.first + grainSize);
+        submit(job);
+    }
+    for (size_t i = 0; i < numJobs; i++)
+        wait(jobs[i]);
+    delete [] jobs;
+}
+
+
+template <class SpriteType, class Function>
+void
+JobSystem::parallelForEach(std::vector<SpriteType *> &sprites,
+                           size_t grainSize, Function &f)
+{
+    ForEachFunction<SpriteType, Function> fe(sprites, f);
+    parallelFor(0, sprites.size(), grainSize, fe);
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_JobSystem */
@@ -22,6 +22,10 @@
 
 #include "Joystick.h"
 
+#include "InputLog.h"
+
+#include <algorithm>
+
 
 using namespace std;
 using namespace flatzebra;
@@ -30,9 +34,14 @@ using namespace flatzebra;
 Joystick::Joystick()
 :   joystick(NULL),
     joystickButtons(),
+    currentButtons(),
+    axes(),
     xAxis(),
-    yAxis()
+    yAxis(),
+    inputLog(NULL)
 {
+    for (size_t i = 0; i < NUM_AXES; i++)
+        axes[i] = 0;
     xAxis[0] = xAxis[1] = 0;
     yAxis[0] = yAxis[1] = 0;
 
@@ -40,7 +49,10 @@ Joystick::Joystick()
     {
         joystick = SDL_JoystickOpen(0);
         if (joystick != NULL)
+        {
             joystickButtons.resize(size_t(SDL_JoystickNumButtons(joystick)), false);
+            currentButtons.resize(joystickButtons.size(), false);
+        }
     }
 }
 
@@ -66,14 +78,20 @@ Joystick::~Joystick()
 }
 
 
+void
+Joystick::attachInputLog(InputLog *log)
+{
+    inputLog = log;
+}
+
+
 bool
 Joystick::getButton(int buttonNumber) const
 {
-    if (joystick == NULL)  // if no joystick detected
+    // No buttons if no joystick detected and no replay.
+    if (buttonNumber < 0 || buttonNumber >= static_cast<int>(currentButtons.size()))
         return false;
-    if (buttonNumber < 0 || buttonNumber >= static_cast<int>(joystickButtons.size()))
-        return false;
-    return SDL_JoystickGetButton(joystick, buttonNumber) != 0;
+    return currentButtons[static_cast<size_t>(buttonNumber)];
 }
 
 
@@ -109,25 +127,55 @@ Joystick::getYAxisDisplacement(int stickNumber) const
 int
 Joystick::getTriggerValue(int triggerNumber) const
 {
-    return SDL_JoystickGetAxis(joystick, triggerNumber);
+    if (triggerNumber < 0 || triggerNumber >= NUM_AXES)
+        return 0;
+    return axes[triggerNumber];
 }
 
 
 void
 Joystick::update()
 {
-    if (joystick == NULL)
-        return;
+    if (inputLog != NULL && inputLog->getMode() == InputLog::REPLAYING)
+    {
+        const vector<bool> &loggedButtons = inputLog->getJoystickButtons();
+        if (loggedButtons.size() > currentButtons.size())
+        {
+            currentButtons.resize(loggedButtons.size(), false);
+            joystickButtons.resize(loggedButtons.size(), false);
+        }
+
+        // Remember current joystick button states for next frame.
+        joystickButtons = currentButtons;
+
+        fill(currentButtons.begin(), currentButtons.end(), false);
+        copy(loggedButtons.begin(), loggedButtons.end(), currentButtons.begin());
+        const Sint16 *loggedAxes = inputLog->getJoystickAxes();
+        copy(loggedAxes, loggedAxes + NUM_AXES, axes);
+    }
+    else
+    {
+        if (joystick == NULL)
+            return;
 
-    // Remember current joystick button states for next frame.
-    for (size_t i = joystickButtons.size(); i--; )
-        joystickButtons[static_cast<size_t>(i)] = (getButton(i) != 0);
+        // Remember current joystick button states for next frame.
+        joystickButtons = currentButtons;
 
-    // Update joystick button states.
-    SDL_JoystickUpdate();
+        // Update joystick button states.
+        SDL_JoystickUpdate();
+
+        for (size_t i = currentButtons.size(); i--; )
+            currentButtons[i] = (SDL_JoystickGetButton(joystick, int(i)) != 0);
+        int numAxes = SDL_JoystickNumAxes(joystick);
+        for (int i = 0; i < NUM_AXES; i++)
+            axes[i] = (i < numAxes ? SDL_JoystickGetAxis(joystick, i) : 0);
+
+        if (inputLog != NULL)
+            inputLog->recordJoystick(currentButtons, axes);
+    }
 
-    xAxis[0] = SDL_JoystickGetAxis(joystick, MAIN_X);
-    yAxis[0] = SDL_JoystickGetAxis(joystick, MAIN_Y);
-    xAxis[1] = SDL_JoystickGetAxis(joystick, SECONDARY_X);
-    yAxis[1] = SDL_JoystickGetAxis(joystick, SECONDARY_Y);
+    xAxis[0] = axes[MAIN_X];
+    yAxis[0] = axes[MAIN_Y];
+    xAxis[1] = axes[SECONDARY_X];
+    yAxis[1] = axes[SECONDARY_Y];
 }
@@ -31,6 +31,9 @@
 namespace flatzebra {
 
 
+class InputLog;
+
+
 // In this version of flatzebra, this class is merely experimental
 // and only supports the Xbox 360 USB controller.
 //
@@ -139,6 +142,16 @@ public:
     */
     size_t getNumButtons() const;
 
+    /*  Attaches an input log, or detaches it if 'log' is NULL.
+        The log is not owned.
+        If the log is recording, update() appends the joystick state
+        to it whenever the state changes.
+        If the log is replaying, update() takes the state from the log
+        instead of the device, even if no joystick was detected.
+        See GameEngine::setInputLog().
+    */
+    void attachInputLog(InputLog *log);
+
 private:
 
     /*  Value (between 0 and 32767) beyond which an axis is considered
@@ -147,10 +160,15 @@ private:
     */
     enum { AXIS_THRESHOLD = 16000 };
 
+    enum { NUM_AXES = 6 };  // same as InputLog::NUM_JOYSTICK_AXES
+
     SDL_Joystick *joystick;
     std::vector<bool> joystickButtons;  // previous state of buttons
+    std::vector<bool> currentButtons;  // state read by the last update()
+    Sint16 axes[NUM_AXES];  // state read by the last update()
     Sint16 xAxis[2];  // -32768..32767
     Sint16 yAxis[2];  // -32768..32767
+    InputLog *inputLog;  // NULL if none
 
     // Forbidden operations:
     Joystick(const Joystick &);
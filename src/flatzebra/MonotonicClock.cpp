@@ -0,0 +1,58 @@
+/*  $Id$
+    MonotonicClock.cpp - High-resolution clock that never goes backwards.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/MonotonicClock.h>
+
+#include <SDL.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace flatzebra;
+
+
+/*static*/
+Uint64
+MonotonicClock::getNanoseconds() throw()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = { { 0, 0 } };
+    if (frequency.QuadPart == 0 && !QueryPerformanceFrequency(&frequency))
+        frequency.QuadPart = -1;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart > 0 && QueryPerformanceCounter(&counter))
+    {
+        // Split the conversion to avoid overflowing 64 bits.
+        Uint64 f = Uint64(frequency.QuadPart), c = Uint64(counter.QuadPart);
+        return c / f * 1000000000 + c % f * 1000000000 / f;
+    }
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return Uint64(ts.tv_sec) * 1000000000 + Uint64(ts.tv_nsec);
+#endif
+    return Uint64(SDL_GetTicks()) * 1000000;
+}
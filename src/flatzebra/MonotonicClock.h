@@ -0,0 +1,83 @@
+/*  $Id$
+    MonotonicClock.h - High-resolution clock that never goes backwards.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_MonotonicClock
+#define _H_MonotonicClock
+
+#include <SDL_types.h>
+
+
+namespace flatzebra {
+
+
+class MonotonicClock
+/*  Clock that measures elapsed time in nanoseconds.
+    Unlike SDL_GetTicks(), it has sub-millisecond resolution, and unlike
+    the time of day, it is not affected by changes to the system clock.
+    Uses clock_gettime(CLOCK_MONOTONIC) on POSIX systems and
+    QueryPerformanceCounter() on Windows.
+*/
+{
+public:
+
+    static Uint64 getNanoseconds() throw();
+    /*  Returns the number of nanoseconds elapsed since an unspecified
+        point in the past. Only differences between two values are
+        meaningful.
+        Falls back to SDL_GetTicks() if no high-resolution clock
+        is available.
+    */
+
+    static double toSeconds(Uint64 nanoseconds) throw();
+    static Uint64 fromSeconds(double seconds) throw();
+    /*  Conversions between nanoseconds and seconds.
+    */
+
+private:
+
+    /*  Forbidden operations:
+    */
+    MonotonicClock();
+};
+
+
+inline
+double
+MonotonicClock::toSeconds(Uint64 nanoseconds) throw()
+{
+    return double(nanoseconds) / 1e9;
+}
+
+
+inline
+Uint64
+MonotonicClock::fromSeconds(double seconds) throw()
+{
+    return Uint64(seconds * 1e9 + 0.5);
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_MonotonicClock */
@@ -0,0 +1,162 @@
+/*  $Id$
+    PixelMask.cpp - Bit mask of the opaque pixels of an image.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <flatzebra/PixelMask.h>
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+static Uint32
+getPixel(const SDL_Surface *surface, int x, int y)
+{
+    int bpp = surface->format->BytesPerPixel;
+    const Uint8 *p = (const Uint8 *) surface->pixels + y * surface->pitch + x * bpp;
+
+    switch (bpp)
+    {
+        case 1:
+            return *p;
+        case 2:
+            return * (const Uint16 *) p;
+        case 3:
+            if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+                return (Uint32(p[0]) << 16) | (Uint32(p[1]) << 8) | p[2];
+            return p[0] | (Uint32(p[1]) << 8) | (Uint32(p[2]) << 16);
+        case 4:
+            return * (const Uint32 *) p;
+    }
+    return 0;
+}
+
+
+// Returns the 64 pixels of 'row' that start at column 'x',
+// which may be negative or beyond the end of the row.
+//
+static inline Uint64
+getBits(const Uint64 *row, int numWords, int x)
+{
+    int j = (x >= 0 ? x / 64 : -((-x - 1) / 64) - 1);  // floor(x / 64)
+    int shift = x - j * 64;
+    Uint64 w0 = (j >= 0 && j < numWords ? row[j] : 0);
+    if (shift == 0)
+        return w0;
+    Uint64 w1 = (j + 1 >= 0 && j + 1 < numWords ? row[j + 1] : 0);
+    return (w0 << shift) | (w1 >> (64 - shift));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+PixelMask::PixelMask()
+  : width(0),
+    height(0),
+    wordsPerRow(0),
+    bits()
+{
+}
+
+
+void
+PixelMask::build(SDL_Surface *image)
+{
+    assert(image != NULL);
+
+    width = image->w;
+    height = image->h;
+    wordsPerRow = (size_t(width) + 63) / 64;
+    bits.assign(wordsPerRow * size_t(height), 0);  // padding bits stay zero
+
+    const SDL_PixelFormat *fmt = image->format;
+    bool useColorKey = (image->flags & SDL_SRCCOLORKEY) != 0;
+    Uint32 alphaMask = fmt->Amask;
+
+    if (SDL_MUSTLOCK(image) && SDL_LockSurface(image) != 0)
+    {
+        bits.assign(bits.size(), ~Uint64(0));  // assume fully opaque
+        return;
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+        Uint64 *row = &bits[size_t(y) * wordsPerRow];
+        for (int x = 0; x < width; x++)
+        {
+            Uint32 pixel = getPixel(image, x, y);
+            bool opaque;
+            if (useColorKey)
+                opaque = (pixel != fmt->colorkey);
+            else if (alphaMask != 0)
+                opaque = (pixel & alphaMask) != 0;
+            else
+                opaque = true;
+            if (opaque)
+                row[x / 64] |= Uint64(1) << (63 - x % 64);
+        }
+    }
+
+    if (SDL_MUSTLOCK(image))
+        SDL_UnlockSurface(image);
+}
+
+
+/*static*/
+bool
+PixelMask::overlap(const PixelMask &m1, Couple pos1,
+                   const PixelMask &m2, Couple pos2)
+{
+    // Intersection of the two rectangles, in m1's coordinates.
+    int left   = max(0, pos2.x - pos1.x);
+    int top    = max(0, pos2.y - pos1.y);
+    int right  = min(m1.width,  pos2.x + m2.width  - pos1.x);
+    int bottom = min(m1.height, pos2.y + m2.height - pos1.y);
+    if (left >= right || top >= bottom)
+        return false;
+
+    /*  Compare the words of m1 that cover columns 'left' to 'right' - 1
+        with the same columns of m2, extracted with shifts.
+        Columns outside of either mask read as zero, so no other
+        masking is needed.
+    */
+    const int dx = pos1.x - pos2.x;  // m2 column = m1 column + dx
+    const int dy = pos1.y - pos2.y;
+    const int firstWord = left / 64;
+    const int lastWord = (right - 1) / 64;
+    const int numWords2 = int(m2.wordsPerRow);
+
+    for (int y = top; y < bottom; y++)
+    {
+        const Uint64 *row1 = m1.getRow(y);
+        const Uint64 *row2 = m2.getRow(y + dy);
+        for (int k = firstWord; k <= lastWord; k++)
+            if ((row1[k] & getBits(row2, numWords2, k * 64 + dx)) != 0)
+                return true;
+    }
+    return false;
+}
@@ -0,0 +1,109 @@
+/*  $Id$
+    PixelMask.h - Bit mask of the opaque pixels of an image.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef _H_PixelMask
+#define _H_PixelMask
+
+#include <flatzebra/Couple.h>
+
+#include <SDL.h>
+
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class PixelMask
+/*  Bit mask of the opaque pixels of an image, with one bit per pixel.
+    Used for pixel-perfect collision detection between sprites.
+
+    Each row is stored in 64-bit words, the leftmost pixel being
+    the most significant bit of the first word. Two masks are compared
+    64 pixels at a time.
+*/
+{
+public:
+
+    PixelMask();
+    /*  Creates an empty mask (zero by zero pixels).
+    */
+
+    void build(SDL_Surface *image);
+    /*  Sets this mask from the pixels of 'image'.
+        A pixel is opaque if it is not of the color key of the image,
+        when the image has SDL_SRCCOLORKEY, or if its alpha is not zero,
+        when the image has an alpha channel. Otherwise, all pixels are
+        considered opaque.
+        'image' is locked if necessary, which also decodes an RLE image.
+    */
+
+    int getWidth() const;
+    int getHeight() const;
+    bool isEmpty() const;
+
+    bool isOpaque(int x, int y) const;
+    /*  Indicates if the pixel at (x, y) is opaque.
+        Returns false if (x, y) is outside of the mask.
+    */
+
+    static bool overlap(const PixelMask &m1, Couple pos1,
+                        const PixelMask &m2, Couple pos2);
+    /*  Indicates if an opaque pixel of m1, when placed at 'pos1',
+        falls on an opaque pixel of m2, when placed at 'pos2'.
+    */
+
+private:
+
+    const Uint64 *getRow(int y) const;
+
+    int width, height;
+    size_t wordsPerRow;
+    std::vector<Uint64> bits;  // 'height' rows of 'wordsPerRow' words
+};
+
+
+/*  INLINE METHODS
+*/
+
+inline int
+PixelMask::getWidth() const { return width; }
+inline int
+PixelMask::getHeight() const { return height; }
+inline bool
+PixelMask::isEmpty() const { return width == 0 || height == 0; }
+inline const Uint64 *
+PixelMask::getRow(int y) const { return &bits[size_t(y) * wordsPerRow]; }
+
+inline bool
+PixelMask::isOpaque(int x, int y) const
+{
+    if (x < 0 || y < 0 || x >= width || y >= height)
+        return false;
+    return (getRow(y)[x / 64] >> (63 - x % 64)) & 1;
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_PixelMask */
@@ -22,33 +22,86 @@
 
 #include <flatzebra/PixmapArray.h>
 
+#include <flatzebra/ColorKeyBlitter.h>
+#include <flatzebra/PixmapAtlas.h>
+
+#include <algorithm>
 #include <assert.h>
 
 using namespace std;
 using namespace flatzebra;
 
 
+SDL_Surface *PixmapArray::displaySurface = NULL;
+vector<PixmapArray *> PixmapArray::instances;
+
+
 PixmapArray::PixmapArray(size_t)
   : images(),
-    imageSize(0, 0)
+    displayImages(),
+    displayImageOwned(),
+    imageRects(),
+    masks(),
+    imageSize(0, 0),
+    atlas(NULL)
 {
+    instances.push_back(this);
 }
 
 
 PixmapArray::~PixmapArray()
 {
     freeImages();
+
+    if (atlas != NULL)
+        atlas->removePixmapArray(*this);
+
+    vector<PixmapArray *>::iterator it =
+                        find(instances.begin(), instances.end(), this);
+    assert(it != instances.end());
+    instances.erase(it);
 }
 
 
 void
 PixmapArray::freeImages()
 {
-    for (vector<SDL_Surface *>::iterator it = images.begin();
-                                        it != images.end(); it++)
-        SDL_FreeSurface(*it);
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        freeDisplayImage(i);
+        SDL_FreeSurface(images[i]);
+    }
 
     images.clear();
+    displayImages.clear();
+    displayImageOwned.clear();
+    imageRects.clear();
+    masks.clear();
+}
+
+
+void
+PixmapArray::freeDisplayImage(size_t i)
+{
+    if (displayImageOwned[i])
+        SDL_FreeSurface(displayImages[i]);
+    setDisplayImage(i, images[i], false);
+}
+
+
+void
+PixmapArray::setDisplayImage(size_t i, SDL_Surface *image, bool owned)
+{
+    displayImages[i] = image;
+    displayImageOwned[i] = owned;
+
+    SDL_Rect r = { 0, 0, 0, 0 };
+    if (image != NULL)
+    {
+        r.w = Uint16(image->w);
+        r.h = Uint16(image->h);
+    }
+    imageRects[i] = r;
 }
 
 
@@ -59,9 +112,193 @@ PixmapArray::setArrayElement(size_t i, SDL_Surface *image)
     assert(image != NULL);
 
     if (i >= images.size())
+    {
         images.resize(i + 1, NULL);
+        displayImages.resize(i + 1, NULL);
+        displayImageOwned.resize(i + 1, false);
+        SDL_Rect empty = { 0, 0, 0, 0 };
+        imageRects.resize(i + 1, empty);
+        masks.resize(i + 1);
+    }
+
+    if (images[i] != NULL)
+    {
+        freeDisplayImage(i);
+        SDL_FreeSurface(images[i]);
+    }
 
     images[i] = image;
+    setDisplayImage(i, image, false);
+    masks[i].build(image);
+
+    /*  If this array is in an atlas, the new image stays outside of it
+        until the next PixmapAtlas::build().
+    */
+    SDL_Surface *copy = createDisplayCopy(image);
+    if (copy != NULL)
+        setDisplayImage(i, copy, true);
+}
+
+
+void
+PixmapArray::convertToDisplayFormat()
+{
+    if (atlas != NULL)
+    {
+        atlas->build();
+        return;
+    }
+
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        if (images[i] == NULL)
+            continue;
+        freeDisplayImage(i);
+        SDL_Surface *copy = createDisplayCopy(images[i]);
+        if (copy != NULL)
+            setDisplayImage(i, copy, true);
+    }
+}
+
+
+/*static*/
+void
+PixmapArray::setDisplaySurface(SDL_Surface *surface)
+{
+    displaySurface = surface;
+}
+
+
+/*static*/
+SDL_Surface *
+PixmapArray::getDisplaySurface()
+{
+    return displaySurface != NULL ? displaySurface : SDL_GetVideoSurface();
+}
+
+
+/*static*/
+SDL_Surface *
+PixmapArray::createDisplaySurface(Couple size)
+{
+    SDL_Surface *display = getDisplaySurface();
+    if (display == NULL)
+        return NULL;
+
+    const SDL_PixelFormat *fmt = display->format;
+    SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, size.x, size.y,
+                                                fmt->BitsPerPixel,
+                                                fmt->Rmask, fmt->Gmask, fmt->Bmask, 0);
+    if (surface != NULL && fmt->palette != NULL)
+        SDL_SetColors(surface, fmt->palette->colors, 0, fmt->palette->ncolors);
+    return surface;
+}
+
+
+/*static*/
+bool
+PixmapArray::hasDisplayFormat(const SDL_Surface *surface)
+{
+    SDL_Surface *display = getDisplaySurface();
+    if (display == NULL)
+        return false;
+
+    const SDL_PixelFormat *fmt = display->format;
+    const SDL_PixelFormat *surfaceFmt = surface->format;
+    return surfaceFmt->BitsPerPixel == fmt->BitsPerPixel
+        && surfaceFmt->Rmask == fmt->Rmask
+        && surfaceFmt->Gmask == fmt->Gmask
+        && surfaceFmt->Bmask == fmt->Bmask;
+}
+
+
+/*static*/
+void
+PixmapArray::convertAllToDisplayFormat()
+{
+    for (vector<PixmapArray *>::iterator it = instances.begin();
+                                        it != instances.end(); it++)
+        if ((*it)->atlas == NULL)
+            (*it)->convertToDisplayFormat();
+
+    PixmapAtlas::buildAll();
+}
+
+
+void
+PixmapArray::attachToAtlas(PixmapAtlas *a)
+{
+    assert(a != NULL);
+    atlas = a;
+}
+
+
+void
+PixmapArray::setAtlasImage(size_t i, SDL_Surface *page, const SDL_Rect &r)
+{
+    assert(atlas != NULL);
+    assert(page != NULL);
+
+    if (displayImageOwned[i])
+        SDL_FreeSurface(displayImages[i]);
+    displayImages[i] = page;
+    displayImageOwned[i] = false;
+    imageRects[i] = r;
+}
+
+
+void
+PixmapArray::detachFromAtlas()
+{
+    // Forget the pages, which belong to the atlas.
+    for (size_t i = 0; i < images.size(); i++)
+        if (!displayImageOwned[i])
+            setDisplayImage(i, images[i], false);
+
+    atlas = NULL;
+    convertToDisplayFormat();
+}
+
+
+/*static*/
+SDL_Surface *
+PixmapArray::createDisplayCopy(SDL_Surface *image)
+{
+    SDL_Surface *display = getDisplaySurface();
+    if (display == NULL)  // no video mode set yet
+        return NULL;
+
+    bool hasAlpha = (image->format->Amask != 0
+                        && (image->flags & SDL_SRCALPHA) != 0);
+    SDL_Surface *copy;
+    if (display == SDL_GetVideoSurface())
+        copy = (hasAlpha
+                        ? SDL_DisplayFormatAlpha(image)
+                        : SDL_DisplayFormat(image));
+    else if (hasAlpha && display->format->Amask == 0)
+        return NULL;  // keep the alpha channel of the original image
+    else
+        copy = SDL_ConvertSurface(image, display->format,
+                    SDL_SWSURFACE | (image->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA)));
+    if (copy == NULL)
+        return NULL;  // blits will convert the original image
+
+    /*  SDL_DisplayFormat() keeps the color key of the original image,
+        mapped to the new pixel format.
+        Narrow images are left unencoded for ColorKeyBlitter, which
+        cannot read RLE-encoded pixels: SDL would encode them on their
+        first SDL_BlitSurface() and disable the fast path for good.
+    */
+    if ((copy->flags & SDL_SRCCOLORKEY) != 0)
+    {
+        Uint32 rle = (copy->w > ColorKeyBlitter::MAX_SPRITE_WIDTH
+                                                    ? SDL_RLEACCEL : 0);
+        SDL_SetColorKey(copy, SDL_SRCCOLORKEY | rle, copy->format->colorkey);
+    }
+    else if (hasAlpha)
+        SDL_SetAlpha(copy, SDL_SRCALPHA | SDL_RLEACCEL, SDL_ALPHA_OPAQUE);
+
+    return copy;
 }
 
 
@@ -24,6 +24,7 @@
 #define _H_PixmapArray
 
 #include <flatzebra/Couple.h>
+#include <flatzebra/PixelMask.h>
 
 #include <SDL.h>
 #include <SDL_image.h>
@@ -34,6 +35,9 @@
 namespace flatzebra {
 
 
+class PixmapAtlas;
+
+
 class PixmapArray
 /*  Object containing an array of Pixmaps.
 */
@@ -49,6 +53,7 @@ public:
     PixmapArray(size_t = 0);
 
     /*  Calls freeImages().
+        Removes this array from its atlas, if any.
     */
     ~PixmapArray();
 
@@ -59,14 +64,93 @@ public:
     /*  Returns the pixmap of the image at index 'i' of the
         arrays given to the constructor of this object.
         'i' must be lower than the value returned by getNumImages().
+        The returned surface is the display format copy of the image
+        (see convertToDisplayFormat()) if there is one, or the image
+        passed to setArrayElement() otherwise.
+        If this array is part of a PixmapAtlas, the returned surface is
+        the atlas page that contains the image, and only the rectangle
+        returned by getImageRect() must be blitted.
     */
     SDL_Surface *getImage(size_t i) const;
     size_t getNumImages() const;
 
+    /*  Returns the rectangle occupied by image 'i' in the surface
+        returned by getImage(i).
+        Unless this array is part of a PixmapAtlas, this rectangle is
+        at (0, 0) and has the size of the image.
+    */
+    const SDL_Rect &getImageRect(size_t i) const;
+
+    /*  Returns the atlas that contains the images of this array,
+        or NULL if the images are stored in separate surfaces.
+    */
+    const PixmapAtlas *getAtlas() const;
+
+    /*  Returns the image at index 'i' as it was passed to setArrayElement().
+        Use this when the pixels of the image must be read, because
+        the display format copy may be RLE-encoded.
+    */
+    SDL_Surface *getOriginalImage(size_t i) const;
+
+    /*  Returns the mask of the opaque pixels of image 'i', which is
+        built by setArrayElement().
+        See Sprite::collidesWithSpritePixels().
+    */
+    const PixelMask &getMask(size_t i) const;
+
     /*  'image' must not be null.
+        This object becomes the owner of 'image'.
+        If a video mode has been set, a display format copy of 'image'
+        is also created.
+        The PixelMask of the image is built from its color key or
+        alpha channel.
     */
     void setArrayElement(size_t i, SDL_Surface *image);
 
+    /*  Replaces the display format copies of the images of this array
+        with new copies made for the current video mode.
+        A copy is made with SDL_DisplayFormatAlpha() if the original image
+        has an alpha channel, or with SDL_DisplayFormat() otherwise, and
+        its color key or alpha channel gets RLE acceleration, except
+        the color key of images that are at most
+        ColorKeyBlitter::MAX_SPRITE_WIDTH pixels wide, which GameEngine
+        blits without SDL.
+        Blitting such a copy onto the screen does not require any
+        pixel format conversion.
+        Does nothing if no video mode has been set and no display
+        surface has been given to setDisplaySurface().
+        If this array is part of a PixmapAtlas, the whole atlas is
+        rebuilt instead.
+    */
+    void convertToDisplayFormat();
+
+    /*  Calls convertToDisplayFormat() on every existing PixmapArray.
+        Called by GameEngine::setVideoMode() when the pixel format
+        of the screen changes.
+    */
+    static void convertAllToDisplayFormat();
+
+    /*  Sets or gets the surface whose pixel format the display format
+        copies must have. By default (or after setting a null pointer),
+        this is the video surface.
+        An offscreen surface can be given when no video mode is set,
+        e.g., by a headless GameEngine; the copies are then made with
+        SDL_ConvertSurface(). Images with an alpha channel keep their
+        original format unless that surface also has an alpha channel.
+        Call convertAllToDisplayFormat() after changing it.
+    */
+    static void setDisplaySurface(SDL_Surface *surface);
+    static SDL_Surface *getDisplaySurface();
+
+    static SDL_Surface *createDisplaySurface(Couple size);
+    static bool hasDisplayFormat(const SDL_Surface *surface);
+    /*  Create a software surface of the given size in the pixel format
+        of getDisplaySurface(), without color key nor alpha channel,
+        or return NULL if there is no display surface or if SDL fails.
+        Check whether a surface has that pixel format, e.g., to detect
+        that a cache made with createDisplaySurface() must be recreated.
+    */
+
     /*  Sets or gets the size in pixels of the images in the pixmap array.
         All images in the array are assumed to be of the same size.
         Neither size.x nor size.y are allowed to be zero.
@@ -76,8 +160,32 @@ public:
 
 private:
 
+    static SDL_Surface *createDisplayCopy(SDL_Surface *image);
+    void freeDisplayImage(size_t i);
+    void setDisplayImage(size_t i, SDL_Surface *image, bool owned);
+
+    // Used by PixmapAtlas:
+    void attachToAtlas(PixmapAtlas *a);
+    void setAtlasImage(size_t i, SDL_Surface *page, const SDL_Rect &r);
+    void detachFromAtlas();
+
+    friend class PixmapAtlas;
+
     std::vector<SDL_Surface *> images;
+    std::vector<SDL_Surface *> displayImages;
+        // same size as 'images'; element is a display format copy,
+        // an atlas page or the same pointer as in 'images'
+    std::vector<bool> displayImageOwned;
+        // true if the element of 'displayImages' must be freed by this object
+    std::vector<SDL_Rect> imageRects;
+        // rectangle of each image in its element of 'displayImages'
+    std::vector<PixelMask> masks;  // opaque pixels of each image
     Couple imageSize;  // size in pixels of the images; all assumed same size
+    PixmapAtlas *atlas;  // not owned; NULL if not in an atlas
+
+    static SDL_Surface *displaySurface;  // null means the video surface
+    static std::vector<PixmapArray *> instances;
+        // all existing objects, for convertAllToDisplayFormat()
 
 
     /*  Forbidden operations:
@@ -92,9 +200,17 @@ private:
 */
 
 inline SDL_Surface *
-PixmapArray::getImage(size_t i) const { return images[i]; }
+PixmapArray::getImage(size_t i) const { return displayImages[i]; }
+inline SDL_Surface *
+PixmapArray::getOriginalImage(size_t i) const { return images[i]; }
 inline size_t
 PixmapArray::getNumImages() const { return images.size(); }
+inline const SDL_Rect &
+PixmapArray::getImageRect(size_t i) const { return imageRects[i]; }
+inline const PixelMask &
+PixmapArray::getMask(size_t i) const { return masks[i]; }
+inline const PixmapAtlas *
+PixmapArray::getAtlas() const { return atlas; }
 inline Couple
 PixmapArray::getImageSize() const { return imageSize; }
 
@@ -0,0 +1,284 @@
+/*  $Id$
+    PixmapAtlas.cpp - Large surfaces that contain the images of PixmapArrays.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <flatzebra/PixmapAtlas.h>
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+vector<PixmapAtlas *> PixmapAtlas::instances;
+
+
+bool
+PixmapAtlas::Slot::operator < (const Slot &s) const
+{
+    // Group by kind of page, then put the tallest images first,
+    // which makes the shelves of the packer tighter.
+    if (kind != s.kind)
+        return kind < s.kind;
+    if (height != s.height)
+        return height > s.height;
+    return width > s.width;
+}
+
+
+PixmapAtlas::PixmapAtlas(Couple _pageSize)
+  : pageSize(_pageSize),
+    arrays(),
+    pages(),
+    built(false)
+{
+    assert(pageSize.x > 0 && pageSize.y > 0);
+    instances.push_back(this);
+}
+
+
+PixmapAtlas::~PixmapAtlas()
+{
+    for (vector<PixmapArray *>::iterator it = arrays.begin();
+                                        it != arrays.end(); it++)
+        (*it)->detachFromAtlas();
+    arrays.clear();
+
+    freePages();
+
+    vector<PixmapAtlas *>::iterator it =
+                        find(instances.begin(), instances.end(), this);
+    assert(it != instances.end());
+    instances.erase(it);
+}
+
+
+void
+PixmapAtlas::addPixmapArray(PixmapArray &pa)
+{
+    assert(pa.getAtlas() == NULL);
+    arrays.push_back(&pa);
+    pa.attachToAtlas(this);
+}
+
+
+void
+PixmapAtlas::removePixmapArray(PixmapArray &pa)
+{
+    vector<PixmapArray *>::iterator it =
+                        find(arrays.begin(), arrays.end(), &pa);
+    assert(it != arrays.end());
+    arrays.erase(it);
+    pa.detachFromAtlas();
+}
+
+
+void
+PixmapAtlas::freePages()
+{
+    for (vector<SDL_Surface *>::iterator it = pages.begin();
+                                        it != pages.end(); it++)
+        SDL_FreeSurface(*it);
+    pages.clear();
+}
+
+
+/*static*/
+void
+PixmapAtlas::buildAll()
+{
+    for (vector<PixmapAtlas *>::iterator it = instances.begin();
+                                        it != instances.end(); it++)
+        if ((*it)->built)
+            (*it)->build();
+}
+
+
+void
+PixmapAtlas::build()
+{
+    // Collect the images to pack.
+    vector<Slot> slots;
+    for (vector<PixmapArray *>::iterator it = arrays.begin();
+                                        it != arrays.end(); it++)
+    {
+        PixmapArray *pa = *it;
+        for (size_t i = 0; i < pa->getNumImages(); i++)
+        {
+            SDL_Surface *image = pa->getOriginalImage(i);
+            if (image == NULL)
+                continue;
+
+            Slot slot = { pa, i, image->w, image->h, OPAQUE_PAGE };
+            if (image->format->Amask != 0 && (image->flags & SDL_SRCALPHA) != 0)
+                slot.kind = ALPHA_PAGE;
+            else if ((image->flags & SDL_SRCCOLORKEY) != 0)
+                slot.kind = COLOR_KEY_PAGE;
+            slots.push_back(slot);
+        }
+    }
+    sort(slots.begin(), slots.end());
+
+    /*  Shelf packing: images are placed left to right on a shelf whose
+        height is that of its first (tallest) image; a new shelf is
+        started below when the current one is full, and a new page is
+        started when no shelf fits.
+    */
+    vector<SDL_Surface *> oldPages;
+    oldPages.swap(pages);
+
+    vector<size_t> slotPages(slots.size());
+    vector<SDL_Rect> slotRects(slots.size());
+    SDL_Surface *page = NULL;
+    PageKind kind = OPAQUE_PAGE;
+    int x = 0, y = 0, shelfHeight = 0;
+    size_t numPlaced = 0;
+
+    for (size_t s = 0; s < slots.size(); s++, numPlaced++)
+    {
+        const Slot &slot = slots[s];
+
+        if (page != NULL && slot.kind == kind && x + slot.width > page->w)
+        {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        if (page == NULL || slot.kind != kind
+                || x + slot.width > page->w || y + slot.height > page->h)
+        {
+            if (page != NULL)
+            {
+                finishPage(page, kind);
+                pages.push_back(page);
+            }
+            kind = slot.kind;
+            page = createPage(kind, Couple(max(pageSize.x, slot.width),
+                                           max(pageSize.y, slot.height)));
+            if (page == NULL)
+                break;
+            x = y = shelfHeight = 0;
+        }
+
+        SDL_Surface *image = slot.array->getOriginalImage(slot.index);
+        SDL_Rect dest = { Sint16(x), Sint16(y), 0, 0 };
+        if (kind == ALPHA_PAGE)
+        {
+            // Copy the alpha channel instead of blending with it.
+            Uint8 alpha = image->format->alpha;
+            SDL_SetAlpha(image, 0, alpha);
+            SDL_BlitSurface(image, NULL, page, &dest);
+            SDL_SetAlpha(image, SDL_SRCALPHA, alpha);
+        }
+        else
+            SDL_BlitSurface(image, NULL, page, &dest);
+
+        SDL_Rect r = { Sint16(x), Sint16(y), Uint16(slot.width), Uint16(slot.height) };
+        slotPages[s] = pages.size();
+        slotRects[s] = r;
+
+        x += slot.width;
+        shelfHeight = max(shelfHeight, slot.height);
+    }
+
+    if (page != NULL)
+    {
+        finishPage(page, kind);
+        pages.push_back(page);
+    }
+
+    for (size_t s = 0; s < numPlaced; s++)
+        slots[s].array->setAtlasImage(slots[s].index,
+                                      pages[slotPages[s]], slotRects[s]);
+
+    // If a page could not be created, the remaining images must not
+    // refer to the old pages anymore: fall back to their originals.
+    for (size_t s = numPlaced; s < slots.size(); s++)
+        slots[s].array->freeDisplayImage(slots[s].index);
+
+    for (vector<SDL_Surface *>::iterator it = oldPages.begin();
+                                        it != oldPages.end(); it++)
+        SDL_FreeSurface(*it);
+
+    built = true;
+}
+
+
+SDL_Surface *
+PixmapAtlas::createPage(PageKind kind, Couple size) const
+{
+    const SDL_Surface *screen = PixmapArray::getDisplaySurface();
+    SDL_Surface *page;
+    if (kind == ALPHA_PAGE || screen == NULL)
+    {
+        // Work in 32-bit ARGB; finishPage() converts alpha pages.
+        page = SDL_CreateRGBSurface(SDL_SWSURFACE, size.x, size.y, 32,
+                                    0x00FF0000, 0x0000FF00, 0x000000FF,
+                                    kind == ALPHA_PAGE ? 0xFF000000 : 0);
+    }
+    else
+    {
+        const SDL_PixelFormat *fmt = screen->format;
+        page = SDL_CreateRGBSurface(SDL_SWSURFACE, size.x, size.y,
+                                    fmt->BitsPerPixel,
+                                    fmt->Rmask, fmt->Gmask, fmt->Bmask, 0);
+        if (page != NULL && fmt->palette != NULL)
+            SDL_SetColors(page, fmt->palette->colors, 0, fmt->palette->ncolors);
+    }
+    if (page == NULL)
+        return NULL;
+
+    if (kind == COLOR_KEY_PAGE)
+        SDL_FillRect(page, NULL, SDL_MapRGB(page->format, 255, 0, 255));
+    else
+        SDL_FillRect(page, NULL, 0);
+    return page;
+}
+
+
+void
+PixmapAtlas::finishPage(SDL_Surface *&page, PageKind kind) const
+{
+    switch (kind)
+    {
+        case COLOR_KEY_PAGE:
+            SDL_SetColorKey(page, SDL_SRCCOLORKEY | SDL_RLEACCEL,
+                                SDL_MapRGB(page->format, 255, 0, 255));
+            break;
+
+        case ALPHA_PAGE:
+            if (SDL_GetVideoSurface() != NULL)
+            {
+                SDL_Surface *converted = SDL_DisplayFormatAlpha(page);
+                if (converted != NULL)
+                {
+                    SDL_FreeSurface(page);
+                    page = converted;
+                }
+            }
+            SDL_SetAlpha(page, SDL_SRCALPHA | SDL_RLEACCEL, SDL_ALPHA_OPAQUE);
+            break;
+
+        case OPAQUE_PAGE:
+            break;
+    }
+}
@@ -0,0 +1,136 @@
+/*  $Id$
+    PixmapAtlas.h - Large surfaces that contain the images of PixmapArrays.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef _H_PixmapAtlas
+#define _H_PixmapAtlas
+
+#include <flatzebra/Couple.h>
+#include <flatzebra/PixmapArray.h>
+
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class PixmapAtlas
+/*  Set of large surfaces ("pages") into which the images of one or more
+    PixmapArrays are packed.
+
+    Once build() has been called, PixmapArray::getImage() returns the page
+    that contains the requested image and PixmapArray::getImageRect()
+    returns the position of the image in that page.
+    GameEngine::copySpritePixmap() takes care of this.
+
+    Images with a color key, opaque images and images with an alpha
+    channel are packed into separate pages. Pages that contain color
+    keyed images use magenta (255, 0, 255) as their color key, so the
+    opaque pixels of these images must not be of that color.
+*/
+{
+public:
+
+    /*  Creates an empty atlas whose pages will be of the given size
+        in pixels. An image that is larger than this size gets a page
+        of its own.
+    */
+    PixmapAtlas(Couple pageSize = Couple(1024, 1024));
+
+    /*  Gives the images back to their arrays and frees the pages.
+    */
+    ~PixmapAtlas();
+
+    /*  Adds the images of 'pa' to this atlas.
+        This object does not become the owner of 'pa'.
+        'pa' must not already be part of an atlas.
+        The images are only packed by the next call to build().
+    */
+    void addPixmapArray(PixmapArray &pa);
+
+    /*  Gives the images of 'pa' back to 'pa', which gets its own
+        display format copies again.
+        The space occupied by these images in the pages is only
+        reclaimed by the next call to build().
+    */
+    void removePixmapArray(PixmapArray &pa);
+
+    /*  (Re)packs the current images of all the arrays of this atlas
+        into new pages in the display format.
+        Must be called after loading the images into the arrays.
+        Called automatically when the pixel format of the screen changes.
+    */
+    void build();
+
+    /*  Calls build() on every existing atlas that has been built.
+    */
+    static void buildAll();
+
+    size_t getNumPages() const;
+    SDL_Surface *getPage(size_t i) const;
+    /*  Access to the surfaces created by build().
+    */
+
+private:
+
+    enum PageKind { OPAQUE_PAGE, COLOR_KEY_PAGE, ALPHA_PAGE };
+
+    struct Slot
+    {
+        PixmapArray *array;
+        size_t index;
+        int width, height;
+        PageKind kind;
+
+        bool operator < (const Slot &s) const;
+    };
+
+    SDL_Surface *createPage(PageKind kind, Couple size) const;
+    void finishPage(SDL_Surface *&page, PageKind kind) const;
+    void freePages();
+
+    Couple pageSize;
+    std::vector<PixmapArray *> arrays;  // not owned
+    std::vector<SDL_Surface *> pages;
+    bool built;
+
+    static std::vector<PixmapAtlas *> instances;
+
+    /*  Forbidden operations:
+    */
+    PixmapAtlas(const PixmapAtlas &x);
+    PixmapAtlas &operator = (const PixmapAtlas &x);
+};
+
+
+/*  INLINE METHODS
+*/
+
+inline size_t
+PixmapAtlas::getNumPages() const { return pages.size(); }
+inline SDL_Surface *
+PixmapAtlas::getPage(size_t i) const { return pages[i]; }
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_PixmapAtlas */
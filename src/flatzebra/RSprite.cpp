@@ -85,6 +85,17 @@ bool RSprite::collidesWithRSprite(const RSprite &s) const
 }
 
 
+bool RSprite::collidesWithRSpritePixels(const RSprite &s) const
+{
+    if (!collidesWithRSprite(s))
+        return false;
+
+    const PixelMask &m1 = thePixmapArray->getMask(currentPixmapIndex);
+    const PixelMask &m2 = s.thePixmapArray->getMask(s.currentPixmapIndex);
+    return PixelMask::overlap(m1, pos.round(), m2, s.pos.round());
+}
+
+
 void RSprite::boundPosition(Couple settingSizeInPixels)
 /*  If the position of sprite 's' is out of the setting, then this
     position is adjusted to bring the sprite back in.
@@ -129,6 +129,15 @@ public:
         with the collision box of this sprite.
     */
 
+    bool collidesWithRSpritePixels(const RSprite &s) const;
+    /*  Returns true if collidesWithRSprite() returns true and if an opaque
+        pixel of the current pixmap of sprite 's' (see currentPixmapIndex)
+        falls on an opaque pixel of the current pixmap of this sprite.
+        Uses the PixelMask objects of the pixmap arrays.
+        The box test is done first, so this method is cheap for sprites
+        that are not close.
+    */
+
     void setTimeToLive(unsigned long t);
     unsigned long getTimeToLive() const;
     unsigned long decTimeToLive();
@@ -0,0 +1,134 @@
+/*  $Id$
+    ScrollingBackground.cpp - Cached view of a large static background.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/ScrollingBackground.h>
+
+#include <flatzebra/PixmapArray.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+ScrollingBackground::ScrollingBackground(Couple _size)
+  : size(_size),
+    origin(0, 0),
+    front(0),
+    valid(false),
+    numPixelsDrawn(0)
+{
+    assert(size.x > 0 && size.y > 0);
+    buffers[0] = buffers[1] = NULL;
+}
+
+
+/*virtual*/
+ScrollingBackground::~ScrollingBackground()
+{
+    SDL_FreeSurface(buffers[0]);
+    SDL_FreeSurface(buffers[1]);
+}
+
+
+bool
+ScrollingBackground::createBuffers()
+{
+    if (PixmapArray::getDisplaySurface() == NULL)
+        return buffers[0] != NULL;  // keep the current ones, if any
+    if (buffers[0] != NULL && PixmapArray::hasDisplayFormat(buffers[0]))
+        return true;
+
+    for (int i = 0; i < 2; i++)
+    {
+        SDL_FreeSurface(buffers[i]);
+        buffers[i] = PixmapArray::createDisplaySurface(size);
+    }
+    if (buffers[0] == NULL || buffers[1] == NULL)
+    {
+        SDL_FreeSurface(buffers[0]);
+        SDL_FreeSurface(buffers[1]);
+        buffers[0] = buffers[1] = NULL;
+        return false;
+    }
+    valid = false;
+    return true;
+}
+
+
+void
+ScrollingBackground::draw(SDL_Surface *dest, Couple destPos, Couple regionSize)
+{
+    SDL_Rect clip = { Sint16(destPos.x), Sint16(destPos.y),
+                      Uint16(regionSize.x), Uint16(regionSize.y) };
+    SDL_SetClipRect(dest, &clip);
+    drawRegion(dest, destPos, origin + destPos, regionSize);
+    SDL_SetClipRect(dest, NULL);
+    numPixelsDrawn += (unsigned long) regionSize.x * regionSize.y;
+}
+
+
+bool
+ScrollingBackground::scrollTo(Couple worldOrigin)
+{
+    if (!createBuffers())
+        return false;
+
+    Couple delta = worldOrigin - origin;
+    origin = worldOrigin;
+    int adx = abs(delta.x), ady = abs(delta.y);
+
+    if (!valid || adx >= size.x || ady >= size.y)
+    {
+        draw(buffers[front], Couple(0, 0), size);
+        valid = true;
+        return true;
+    }
+    if (adx == 0 && ady == 0)
+        return true;
+
+    /*  Copy the part of the previous view that remains visible.
+        The back buffer is used because SDL_BlitSurface() does not
+        support overlapping source and destination rectangles.
+    */
+    SDL_Surface *back = buffers[1 - front];
+    Couple kept(size.x - adx, size.y - ady);  // size of the copied part
+    Couple keptPos(max(-delta.x, 0), max(-delta.y, 0));  // in the new view
+    SDL_Rect srcrect = { Sint16(max(delta.x, 0)), Sint16(max(delta.y, 0)),
+                         Uint16(kept.x), Uint16(kept.y) };
+    SDL_Rect dstrect = { Sint16(keptPos.x), Sint16(keptPos.y), 0, 0 };
+    SDL_BlitSurface(buffers[front], &srcrect, back, &dstrect);
+
+    // Newly exposed columns, over the whole height.
+    if (adx != 0)
+        draw(back, Couple(delta.x > 0 ? kept.x : 0, 0), Couple(adx, size.y));
+
+    // Newly exposed rows, over the copied columns only.
+    if (ady != 0)
+        draw(back, Couple(keptPos.x, delta.y > 0 ? kept.y : 0), Couple(kept.x, ady));
+
+    front = 1 - front;
+    return true;
+}
@@ -0,0 +1,143 @@
+/*  $Id$
+    ScrollingBackground.h - Cached view of a large static background.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_ScrollingBackground
+#define _H_ScrollingBackground
+
+#include <flatzebra/Couple.h>
+
+#include <SDL.h>
+
+
+namespace flatzebra {
+
+
+class ScrollingBackground
+/*  Cached view of a large static background, e.g., the terrain of
+    a world seen through a Viewport.
+
+    The cache is a surface of the size of the view, in the display format
+    (see PixmapArray::getDisplaySurface()). When the view scrolls by
+    less than its size, the part of the previous view that remains
+    visible is copied to its new place and only the newly exposed strips
+    are drawn, by calling drawRegion(). This replaces redrawing the whole
+    background every frame with one copy of the view and a few thin
+    strips.
+
+    A derived class implements drawRegion(). It calls invalidate()
+    when the background changes.
+    See GameEngine::copyBackground().
+*/
+{
+public:
+
+    ScrollingBackground(Couple size);
+    /*  'size' is the size of the view in pixels, normally that of the
+        Viewport. Both components must be positive.
+        The cache is created by the first call to scrollTo().
+    */
+
+    virtual ~ScrollingBackground();
+
+    bool scrollTo(Couple worldOrigin);
+    /*  Brings the cache up to date for a view whose upper-left corner
+        is at 'worldOrigin'.
+        Everything is redrawn after invalidate(), after a change of
+        the display format, or when the view has moved by its width or
+        height or more since the previous call.
+        Returns false if no cache could be created, e.g., because no
+        video mode has been set.
+    */
+
+    void invalidate();
+    /*  Forces the next call to scrollTo() to redraw the whole view.
+    */
+
+    SDL_Surface *getSurface() const;
+    /*  Returns the cache, or NULL if scrollTo() has not succeeded yet.
+        The returned surface changes with each scroll, so it must
+        not be kept across calls to scrollTo().
+    */
+
+    Couple getSize() const;
+    Couple getOrigin() const;
+    /*  Size of the view, and world position of its upper-left corner
+        as of the last call to scrollTo().
+    */
+
+    unsigned long getNumPixelsDrawn() const;
+    /*  Returns the number of pixels that drawRegion() has been asked
+        to draw since this object was created.
+    */
+
+protected:
+
+    virtual void drawRegion(SDL_Surface *dest, Couple destPos,
+                            Couple worldPos, Couple regionSize) = 0;
+    /*  Must draw the part of the background whose upper-left corner
+        is at 'worldPos' and whose dimensions are 'regionSize' into
+        'dest', with its upper-left corner at 'destPos'.
+        The clipping rectangle of 'dest' is set to that region, so the
+        implementation can blit whole tiles that straddle its edges.
+    */
+
+private:
+
+    bool createBuffers();
+    void draw(SDL_Surface *dest, Couple destPos, Couple regionSize);
+
+    Couple size;
+    Couple origin;
+    SDL_Surface *buffers[2];  // owned; the front one is the current view
+    int front;
+    bool valid;  // false if the front buffer must be entirely redrawn
+    unsigned long numPixelsDrawn;
+
+
+    /*  Forbidden operations:
+    */
+    ScrollingBackground(const ScrollingBackground &);
+    ScrollingBackground &operator = (const ScrollingBackground &);
+
+};
+
+
+/*  INLINE METHODS
+*/
+
+inline void
+ScrollingBackground::invalidate() { valid = false; }
+inline SDL_Surface *
+ScrollingBackground::getSurface() const { return buffers[front]; }
+inline Couple
+ScrollingBackground::getSize() const { return size; }
+inline Couple
+ScrollingBackground::getOrigin() const { return origin; }
+inline unsigned long
+ScrollingBackground::getNumPixelsDrawn() const { return numPixelsDrawn; }
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_ScrollingBackground */
@@ -27,6 +27,7 @@ using namespace flatzebra;
 
 
 SoundMixer::SoundMixer(int numChannels) throw(Error)
+  : telemetry(NULL)
 {
     int chunksize;
     #ifdef _MSC_VER
@@ -64,6 +65,16 @@ SoundMixer::playChunk(Chunk &theSound) throw(Error)
     if (channelNo == -1)
         throw Error("playChunk(): " + string(Mix_GetError()));
     Mix_Volume(channelNo, MIX_MAX_VOLUME);
+
+    if (telemetry != NULL)
+        telemetry->recordInstant("sound play", channelNo);
+}
+
+
+void
+SoundMixer::setTelemetryRecorder(TelemetryRecorder *recorder)
+{
+    telemetry = recorder;
 }
 
 
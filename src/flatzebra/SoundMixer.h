@@ -23,6 +23,8 @@
 #ifndef _H_SoundMixer
 #define _H_SoundMixer
 
+#include <flatzebra/TelemetryRecorder.h>
+
 #include <SDL_mixer.h>
 
 #include <string>
@@ -95,9 +97,17 @@ public:
         On failure, throws the error message as an exception.
     */
 
+    void setTelemetryRecorder(TelemetryRecorder *recorder);
+    /*  Records an instant event named "sound play" in 'recorder' each
+        time playChunk() is called. 'recorder' can be null.
+        See GameEngine::getTelemetry().
+    */
+
 
 private:
 
+    TelemetryRecorder *telemetry;  // not owned; may be null
+
     /*        Forbidden operations:
     */
     SoundMixer(const SoundMixer &x);
@@ -98,6 +98,17 @@ bool Sprite::collidesWithSprite(const Sprite &s) const
 }
 
 
+bool Sprite::collidesWithSpritePixels(const Sprite &s) const
+{
+    if (!collidesWithSprite(s))
+        return false;
+
+    const PixelMask &m1 = thePixmapArray->getMask(currentPixmapIndex);
+    const PixelMask &m2 = s.thePixmapArray->getMask(s.currentPixmapIndex);
+    return PixelMask::overlap(m1, pos, m2, s.pos);
+}
+
+
 void Sprite::boundPosition(Couple settingSizeInPixels)
 /*  If the position of sprite 's' is out of the setting, then this
     position is adjusted to bring the sprite back in.
@@ -0,0 +1,309 @@
+/*  $Id$
+    SpriteGrid.cpp - Spatial hash grid for detecting collisions between sprites.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <flatzebra/SpriteGrid.h>
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+bool
+SpriteGrid::CellRange::operator == (const CellRange &r) const
+{
+    return left == r.left && top == r.top
+            && right == r.right && bottom == r.bottom;
+}
+
+
+bool
+SpriteGrid::CellRange::intersects(const CellRange &r) const
+{
+    return left <= r.right && r.left <= right
+            && top <= r.bottom && r.top <= bottom;
+}
+
+
+SpriteGrid::SpriteGrid(int cellSizeInPixels, size_t numBuckets)
+  : cellSize(cellSizeInPixels),
+    buckets(),
+    bucketMask(0),
+    ranges(),
+    scratchIndices()
+{
+    assert(cellSize > 0);
+    assert(numBuckets > 0);
+
+    size_t n = 1;
+    while (n < numBuckets)
+        n *= 2;
+    buckets.resize(n);
+    bucketMask = n - 1;
+}
+
+
+SpriteGrid::~SpriteGrid()
+{
+}
+
+
+int
+SpriteGrid::cellCoordinate(int pixelCoordinate) const
+{
+    // Round towards negative infinity, unlike the / operator.
+    if (pixelCoordinate >= 0)
+        return pixelCoordinate / cellSize;
+    return -((-pixelCoordinate - 1) / cellSize) - 1;
+}
+
+
+SpriteGrid::CellRange
+SpriteGrid::getCellRange(const Sprite &s) const
+{
+    Couple pos = s.getPos() + s.getCollBoxPos();
+    Couple size = s.getCollBoxSize();
+
+    // The box covers the pixels from pos to pos + size - 1.
+    CellRange r;
+    r.left   = cellCoordinate(pos.x);
+    r.top    = cellCoordinate(pos.y);
+    r.right  = cellCoordinate(pos.x + (size.x > 0 ? size.x - 1 : 0));
+    r.bottom = cellCoordinate(pos.y + (size.y > 0 ? size.y - 1 : 0));
+    return r;
+}
+
+
+size_t
+SpriteGrid::getBucketIndex(int cellX, int cellY) const
+{
+    Uint32 h = (Uint32(cellX) * 73856093U) ^ (Uint32(cellY) * 19349663U);
+    return size_t(h) & bucketMask;
+}
+
+
+void
+SpriteGrid::getBucketIndices(const CellRange &r, vector<size_t> &indices) const
+{
+    indices.clear();
+
+    double numCells = (double(r.right) - r.left + 1) * (double(r.bottom) - r.top + 1);
+    if (numCells >= double(buckets.size()))
+    {
+        for (size_t i = 0; i < buckets.size(); i++)
+            indices.push_back(i);
+        return;
+    }
+
+    for (int y = r.top; y <= r.bottom; y++)
+        for (int x = r.left; x <= r.right; x++)
+            indices.push_back(getBucketIndex(x, y));
+
+    // Two cells of the range may hash to the same bucket.
+    sort(indices.begin(), indices.end());
+    indices.erase(unique(indices.begin(), indices.end()), indices.end());
+}
+
+
+void
+SpriteGrid::addToBuckets(Sprite *s, const CellRange &r)
+{
+    Entry e = { s, r };
+    getBucketIndices(r, scratchIndices);
+    for (vector<size_t>::const_iterator it = scratchIndices.begin();
+                                    it != scratchIndices.end(); it++)
+        buckets[*it].push_back(e);
+}
+
+
+void
+SpriteGrid::removeFromBuckets(Sprite *s, const CellRange &r)
+{
+    getBucketIndices(r, scratchIndices);
+    for (vector<size_t>::const_iterator it = scratchIndices.begin();
+                                    it != scratchIndices.end(); it++)
+    {
+        Bucket &b = buckets[*it];
+        for (size_t i = 0; i < b.size(); i++)
+            if (b[i].sprite == s)
+            {
+                b[i] = b.back();
+                b.pop_back();
+                break;
+            }
+    }
+}
+
+
+void
+SpriteGrid::insertSprite(Sprite *s)
+{
+    assert(s != NULL);
+    assert(ranges.find(s) == ranges.end());
+
+    CellRange r = getCellRange(*s);
+    ranges[s] = r;
+    addToBuckets(s, r);
+}
+
+
+void
+SpriteGrid::insertSprites(const SpriteList &sl)
+{
+    for (SpriteList::const_iterator it = sl.begin(); it != sl.end(); it++)
+        insertSprite(*it);
+}
+
+
+void
+SpriteGrid::removeSprite(Sprite *s)
+{
+    RangeMap::iterator it = ranges.find(s);
+    assert(it != ranges.end());
+    removeFromBuckets(s, it->second);
+    ranges.erase(it);
+}
+
+
+void
+SpriteGrid::clear()
+{
+    for (vector<Bucket>::iterator it = buckets.begin(); it != buckets.end(); it++)
+        it->clear();
+    ranges.clear();
+}
+
+
+void
+SpriteGrid::updateSprite(Sprite *s)
+{
+    RangeMap::iterator it = ranges.find(s);
+    assert(it != ranges.end());
+
+    CellRange r = getCellRange(*s);
+    if (r == it->second)
+        return;  // still in the same cells
+
+    removeFromBuckets(s, it->second);
+    addToBuckets(s, r);
+    it->second = r;
+}
+
+
+void
+SpriteGrid::updateAll()
+{
+    for (RangeMap::iterator it = ranges.begin(); it != ranges.end(); it++)
+    {
+        CellRange r = getCellRange(*it->first);
+        if (r == it->second)
+            continue;
+
+        removeFromBuckets(it->first, it->second);
+        addToBuckets(it->first, r);
+        it->second = r;
+    }
+}
+
+
+/*  A pair of sprites whose cell ranges intersect is found in every
+    bucket of their common cells. To report it only once, it is only
+    reported from the bucket of the first common cell, i.e., the top left
+    corner of the intersection of the two ranges.
+*/
+
+
+void
+SpriteGrid::getCandidatePairs(SpritePairList &pairs) const
+{
+    for (size_t bi = 0; bi < buckets.size(); bi++)
+    {
+        const Bucket &b = buckets[bi];
+        for (size_t i = 0; i < b.size(); i++)
+        {
+            const CellRange &ri = b[i].range;
+            for (size_t j = i + 1; j < b.size(); j++)
+            {
+                const CellRange &rj = b[j].range;
+                if (!ri.intersects(rj))
+                    continue;
+                if (getBucketIndex(max(ri.left, rj.left),
+                                   max(ri.top, rj.top)) != bi)
+                    continue;
+                pairs.push_back(make_pair(b[i].sprite, b[j].sprite));
+            }
+        }
+    }
+}
+
+
+void
+SpriteGrid::getCollidingPairs(SpritePairList &pairs) const
+{
+    size_t first = pairs.size();
+    getCandidatePairs(pairs);
+
+    size_t kept = first;
+    for (size_t i = first; i < pairs.size(); i++)
+        if (pairs[i].first->collidesWithSprite(*pairs[i].second))
+            pairs[kept++] = pairs[i];
+    pairs.resize(kept);
+}
+
+
+void
+SpriteGrid::getNeighbors(const Sprite &s, SpriteList &neighbors) const
+{
+    CellRange r = getCellRange(s);
+    getBucketIndices(r, scratchIndices);
+
+    for (vector<size_t>::const_iterator it = scratchIndices.begin();
+                                    it != scratchIndices.end(); it++)
+    {
+        const Bucket &b = buckets[*it];
+        for (size_t i = 0; i < b.size(); i++)
+        {
+            const Entry &e = b[i];
+            if (e.sprite == &s || !e.range.intersects(r))
+                continue;
+            if (getBucketIndex(max(r.left, e.range.left),
+                               max(r.top, e.range.top)) != *it)
+                continue;
+            neighbors.push_back(e.sprite);
+        }
+    }
+}
+
+
+void
+SpriteGrid::getCollidingSprites(const Sprite &s, SpriteList &colliders) const
+{
+    size_t first = colliders.size();
+    getNeighbors(s, colliders);
+
+    size_t kept = first;
+    for (size_t i = first; i < colliders.size(); i++)
+        if (s.collidesWithSprite(*colliders[i]))
+            colliders[kept++] = colliders[i];
+    colliders.resize(kept);
+}
@@ -0,0 +1,167 @@
+/*  $Id$
+    SpriteGrid.h - Spatial hash grid for detecting collisions between sprites.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef _H_SpriteGrid
+#define _H_SpriteGrid
+
+#include <flatzebra/Sprite.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+
+namespace flatzebra {
+
+
+typedef std::vector< std::pair<Sprite *, Sprite *> > SpritePairList;
+
+
+class SpriteGrid
+/*  Uniform grid of square cells that remembers which sprites have their
+    collision box (getPos() + getCollBoxPos(), of size getCollBoxSize())
+    in which cells.
+
+    Only the sprites that share a cell can collide, so this avoids
+    testing every pair of sprites with Sprite::collidesWithSprite().
+    The cells are hashed into a fixed number of buckets, so the grid
+    does not need to know the size of the setting, and sprites may
+    have negative coordinates.
+
+    The grid does not watch the sprites: after moving a sprite, call
+    updateSprite() on it, or call updateAll() once per frame.
+*/
+{
+public:
+
+    SpriteGrid(int cellSizeInPixels = 64, size_t numBuckets = 1024);
+    /*  Creates an empty grid.
+        'cellSizeInPixels' should be about the size of the largest
+        collision box among the sprites that will be inserted.
+        'numBuckets' is rounded up to a power of two.
+    */
+
+    ~SpriteGrid();
+    /*  Does not destroy the sprites.
+    */
+
+    void insertSprite(Sprite *s);
+    void insertSprites(const SpriteList &sl);
+    /*  Inserts sprites in the grid, according to their current position.
+        This object does not become the owner of the sprites.
+        A sprite must not be inserted twice.
+    */
+
+    void removeSprite(Sprite *s);
+    /*  Removes a sprite from the grid.
+        Must be called before a sprite that is in the grid is destroyed.
+    */
+
+    void clear();
+    /*  Removes all the sprites from the grid.
+    */
+
+    void updateSprite(Sprite *s);
+    /*  Moves the sprite to the cells that contain its current collision box.
+        This is cheap when the sprite has not left its cells.
+    */
+
+    void updateAll();
+    /*  Calls updateSprite() on every sprite in the grid.
+    */
+
+    size_t getNumSprites() const;
+
+    void getCandidatePairs(SpritePairList &pairs) const;
+    /*  Appends to 'pairs' every pair of sprites that share at least one
+        cell. Each pair is reported once.
+        The sprites of a pair do not necessarily collide.
+    */
+
+    void getCollidingPairs(SpritePairList &pairs) const;
+    /*  Like getCandidatePairs(), but only appends the pairs whose
+        collision boxes intersect, according to Sprite::collidesWithSprite().
+    */
+
+    void getNeighbors(const Sprite &s, SpriteList &neighbors) const;
+    /*  Appends to 'neighbors' every sprite of the grid, other than 's',
+        that shares at least one cell with the collision box of 's'.
+        's' does not need to be in the grid.
+        Each neighbor is reported once.
+    */
+
+    void getCollidingSprites(const Sprite &s, SpriteList &colliders) const;
+    /*  Like getNeighbors(), but only appends the sprites whose collision
+        box intersects that of 's'.
+    */
+
+private:
+
+    struct CellRange
+    {
+        int left, top, right, bottom;  // inclusive cell coordinates
+
+        bool operator == (const CellRange &r) const;
+        bool intersects(const CellRange &r) const;
+    };
+
+    struct Entry
+    {
+        Sprite *sprite;
+        CellRange range;  // copy, to avoid looking it up in 'ranges'
+    };
+
+    typedef std::vector<Entry> Bucket;
+    typedef std::map<Sprite *, CellRange> RangeMap;
+
+    int cellCoordinate(int pixelCoordinate) const;
+    CellRange getCellRange(const Sprite &s) const;
+    size_t getBucketIndex(int cellX, int cellY) const;
+    void getBucketIndices(const CellRange &r,
+                          std::vector<size_t> &indices) const;
+    void addToBuckets(Sprite *s, const CellRange &r);
+    void removeFromBuckets(Sprite *s, const CellRange &r);
+
+    int cellSize;
+    std::vector<Bucket> buckets;
+    size_t bucketMask;  // buckets.size() - 1
+    RangeMap ranges;  // cells currently occupied by each sprite
+    mutable std::vector<size_t> scratchIndices;
+
+    /*  Forbidden operations:
+    */
+    SpriteGrid(const SpriteGrid &x);
+    SpriteGrid &operator = (const SpriteGrid &x);
+};
+
+
+/*  INLINE METHODS
+*/
+
+inline size_t
+SpriteGrid::getNumSprites() const { return ranges.size(); }
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_SpriteGrid */
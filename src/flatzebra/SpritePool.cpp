@@ -0,0 +1,270 @@
+/*  $Id$
+    SpritePool.cpp - Large number of sprites stored as arrays of coordinates.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <flatzebra/SpritePool.h>
+
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+// Moves the last element of 'v' to index 'i' and removes the last element.
+//
+template <class T>
+inline void
+moveLastTo(vector<T> &v, size_t i)
+{
+    v[i] = v.back();
+    v.pop_back();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+template <class Coord, class CoupleType>
+const size_t BasicSpritePool<Coord, CoupleType>::NO_INDEX;
+
+
+template <class Coord, class CoupleType>
+BasicSpritePool<Coord, CoupleType>::BasicSpritePool()
+  : posX(), posY(), speedX(), speedY(), accelX(), accelY(),
+    collBoxX(), collBoxY(), collBoxW(), collBoxH(),
+    sizeX(), sizeY(),
+    timeToLive(),
+    pixmapArrays(),
+    currentPixmapIndices(),
+    handles(),
+    slotIndices(),
+    slotGenerations(),
+    freeSlots()
+{
+}
+
+
+template <class Coord, class CoupleType>
+BasicSpritePool<Coord, CoupleType>::~BasicSpritePool()
+{
+}
+
+
+template <class Coord, class CoupleType>
+typename BasicSpritePool<Coord, CoupleType>::Handle
+BasicSpritePool<Coord, CoupleType>::add(const PixmapArray &pixmapArray,
+                                        const CoupleType &pos,
+                                        const CoupleType &speed,
+                                        const CoupleType &accel,
+                                        const CoupleType &collBoxPos,
+                                        const CoupleType &collBoxSize)
+{
+    size_t slot;
+    if (freeSlots.empty())
+    {
+        slot = slotIndices.size();
+        assert(slot < size_t(SLOT_MASK));
+        slotIndices.push_back(NO_INDEX);
+        slotGenerations.push_back(0);
+    }
+    else
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    Handle h = (slotGenerations[slot] << SLOT_BITS) | Handle(slot + 1);
+    slotIndices[slot] = handles.size();
+    handles.push_back(h);
+
+    posX.push_back(pos.x);
+    posY.push_back(pos.y);
+    speedX.push_back(speed.x);
+    speedY.push_back(speed.y);
+    accelX.push_back(accel.x);
+    accelY.push_back(accel.y);
+    collBoxX.push_back(collBoxPos.x);
+    collBoxY.push_back(collBoxPos.y);
+    collBoxW.push_back(collBoxSize.x);
+    collBoxH.push_back(collBoxSize.y);
+    Couple size = pixmapArray.getImageSize();
+    sizeX.push_back(size.x);
+    sizeY.push_back(size.y);
+    timeToLive.push_back(0);
+    pixmapArrays.push_back(&pixmapArray);
+    currentPixmapIndices.push_back(0);
+
+    return h;
+}
+
+
+template <class Coord, class CoupleType>
+void
+BasicSpritePool<Coord, CoupleType>::remove(Handle h)
+{
+    assert(isValid(h));
+    size_t slot = (h & SLOT_MASK) - 1;
+    size_t i = slotIndices[slot];
+
+    // The last sprite takes the place of the removed one.
+    Handle last = handles.back();
+    slotIndices[(last & SLOT_MASK) - 1] = i;
+    moveLastTo(handles, i);
+
+    moveLastTo(posX, i);
+    moveLastTo(posY, i);
+    moveLastTo(speedX, i);
+    moveLastTo(speedY, i);
+    moveLastTo(accelX, i);
+    moveLastTo(accelY, i);
+    moveLastTo(collBoxX, i);
+    moveLastTo(collBoxY, i);
+    moveLastTo(collBoxW, i);
+    moveLastTo(collBoxH, i);
+    moveLastTo(sizeX, i);
+    moveLastTo(sizeY, i);
+    moveLastTo(timeToLive, i);
+    moveLastTo(pixmapArrays, i);
+    moveLastTo(currentPixmapIndices, i);
+
+    slotIndices[slot] = NO_INDEX;
+    slotGenerations[slot] = (slotGenerations[slot] + 1) & GENERATION_MASK;
+    freeSlots.push_back(slot);
+}
+
+
+template <class Coord, class CoupleType>
+void
+BasicSpritePool<Coord, CoupleType>::clear()
+{
+    while (!handles.empty())
+        remove(handles.back());
+}
+
+
+template <class Coord, class CoupleType>
+void
+BasicSpritePool<Coord, CoupleType>::reserve(size_t n)
+{
+    posX.reserve(n);
+    posY.reserve(n);
+    speedX.reserve(n);
+    speedY.reserve(n);
+    accelX.reserve(n);
+    accelY.reserve(n);
+    collBoxX.reserve(n);
+    collBoxY.reserve(n);
+    collBoxW.reserve(n);
+    collBoxH.reserve(n);
+    sizeX.reserve(n);
+    sizeY.reserve(n);
+    timeToLive.reserve(n);
+    pixmapArrays.reserve(n);
+    currentPixmapIndices.reserve(n);
+    handles.reserve(n);
+}
+
+
+/*  The following loops are kept free of function calls and of
+    data-dependent branches so that the compiler can vectorize them.
+*/
+
+
+template <class Coord, class CoupleType>
+void
+BasicSpritePool<Coord, CoupleType>::integrate()
+{
+    const size_t n = size();
+    if (n == 0)
+        return;
+
+    Coord *px = &posX[0], *py = &posY[0];
+    Coord *vx = &speedX[0], *vy = &speedY[0];
+    const Coord *ax = &accelX[0], *ay = &accelY[0];
+
+    for (size_t i = 0; i < n; i++)
+    {
+        vx[i] += ax[i];
+        px[i] += vx[i];
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        vy[i] += ay[i];
+        py[i] += vy[i];
+    }
+}
+
+
+template <class Coord, class CoupleType>
+void
+BasicSpritePool<Coord, CoupleType>::boundPositions(Couple settingSizeInPixels)
+{
+    const size_t n = size();
+    if (n == 0)
+        return;
+
+    Coord *px = &posX[0], *py = &posY[0];
+    const int *sx = &sizeX[0], *sy = &sizeY[0];
+    const int w = settingSizeInPixels.x, h = settingSizeInPixels.y;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        Coord x = px[i], limit = Coord(w - sx[i]);
+        x = (x > limit ? limit : x);
+        px[i] = (x < 0 ? 0 : x);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        Coord y = py[i], limit = Coord(h - sy[i]);
+        y = (y > limit ? limit : y);
+        py[i] = (y < 0 ? 0 : y);
+    }
+}
+
+
+template <class Coord, class CoupleType>
+size_t
+BasicSpritePool<Coord, CoupleType>::decTimeToLive()
+{
+    const size_t n = size();
+    if (n == 0)
+        return 0;
+
+    unsigned long *ttl = &timeToLive[0];
+    size_t numZero = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned long t = ttl[i];
+        t -= (t != 0);
+        ttl[i] = t;
+        numZero += (t == 0);
+    }
+    return numZero;
+}
+
+
+// The two kinds of pools provided by the library:
+//
+template class flatzebra::BasicSpritePool<int, Couple>;
+template class flatzebra::BasicSpritePool<double, RCouple>;
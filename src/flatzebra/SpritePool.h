@@ -0,0 +1,406 @@
+/*  $Id$
+    SpritePool.h - Large number of sprites stored as arrays of coordinates.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef _H_SpritePool
+#define _H_SpritePool
+
+#include <flatzebra/Couple.h>
+#include <flatzebra/RCouple.h>
+#include <flatzebra/PixmapArray.h>
+
+#include <vector>
+
+
+namespace flatzebra {
+
+
+template <class Coord, class CoupleType>
+class BasicSpritePool
+/*  Set of sprites whose coordinates are stored in one array per field
+    (x position, y position, x speed, etc.) instead of one object per
+    sprite like Sprite and RSprite.
+
+    The bulk operations (integrate(), boundPositions(), decTimeToLive())
+    are plain loops over contiguous arrays, which the compiler can
+    vectorize, and they do not follow any pointer per sprite.
+
+    Use SpritePool for integer coordinates (like Sprite) and RSpritePool
+    for floating point coordinates (like RSprite).
+
+    A sprite is designated by a Handle, which stays valid until the
+    sprite is removed, or by its index, which is between 0 and size() - 1
+    and can change when another sprite is removed. Loops over all the
+    sprites should use indices.
+*/
+{
+public:
+
+    typedef Uint32 Handle;
+    /*  Never zero for a valid sprite, so zero can be used as "no sprite".
+    */
+
+    BasicSpritePool();
+    ~BasicSpritePool();
+
+    Handle add(const PixmapArray &pixmapArray,
+                const CoupleType &pos,
+                const CoupleType &speed = CoupleType(),
+                const CoupleType &accel = CoupleType(),
+                const CoupleType &collBoxPos = CoupleType(),
+                const CoupleType &collBoxSize = CoupleType());
+    /*  Adds a sprite with the given pixmap array and coordinates,
+        like the constructor of Sprite.
+        Keeps a pointer to 'pixmapArray' but does NOT become the owner
+        of the pixmap array.
+        The sprite gets the index size() - 1.
+    */
+
+    void remove(Handle h);
+    /*  Removes the sprite designated by 'h', which must be valid.
+        The last sprite takes the index of the removed one.
+    */
+
+    void clear();
+    /*  Removes all the sprites.
+    */
+
+    void reserve(size_t n);
+    /*  Allocates memory for 'n' sprites in advance.
+    */
+
+    bool isValid(Handle h) const;
+    /*  Indicates if 'h' designates a sprite of this pool.
+    */
+
+    size_t size() const;
+    size_t getIndex(Handle h) const;
+    Handle getHandle(size_t i) const;
+    /*  Conversions between handles and indices.
+    */
+
+    CoupleType getPos(size_t i) const;
+    CoupleType getSpeed(size_t i) const;
+    CoupleType getAccel(size_t i) const;
+    Couple getSize(size_t i) const;
+    CoupleType getCollBoxPos(size_t i) const;
+    CoupleType getCollBoxSize(size_t i) const;
+    void setPos(size_t i, const CoupleType &c);
+    void setSpeed(size_t i, const CoupleType &c);
+    void setAccel(size_t i, const CoupleType &c);
+    void setCollBoxPos(size_t i, const CoupleType &c);
+    void setCollBoxSize(size_t i, const CoupleType &c);
+    /*  Access to the coordinates of the sprite at index 'i',
+        with the same meaning as in Sprite.
+    */
+
+    unsigned long getTimeToLive(size_t i) const;
+    void setTimeToLive(size_t i, unsigned long t);
+
+    const PixmapArray *getPixmapArray(size_t i) const;
+    SDL_Surface *getPixmap(size_t i, size_t pixmapNo) const;
+    size_t getCurrentPixmapIndex(size_t i) const;
+    void setCurrentPixmapIndex(size_t i, size_t pixmapNo);
+
+    bool collides(size_t i, size_t j) const;
+    /*  Returns true if the collision boxes of the sprites at indices
+        'i' and 'j' intersect (see Sprite::collidesWithSprite()).
+    */
+
+    void integrate();
+    /*  For every sprite, adds the acceleration to the speed, then the
+        speed to the position, like calling addAccelToSpeed() and then
+        addSpeedToPos() on a Sprite.
+    */
+
+    void boundPositions(Couple settingSizeInPixels);
+    /*  Applies Sprite::boundPosition() to every sprite.
+    */
+
+    size_t decTimeToLive();
+    /*  Decrements the time to live of every sprite whose time to live
+        is not already zero.
+        Returns the number of sprites whose time to live is zero after
+        this operation.
+    */
+
+    Coord *getPosXArray();
+    Coord *getPosYArray();
+    Coord *getSpeedXArray();
+    Coord *getSpeedYArray();
+    Coord *getAccelXArray();
+    Coord *getAccelYArray();
+    /*  Direct access to the arrays, for custom bulk operations.
+        Element 'i' belongs to the sprite at index 'i'.
+        Only valid until the next call to add(), remove() or clear().
+    */
+
+private:
+
+    enum { SLOT_BITS = 24 };
+    enum { SLOT_MASK = (1 << SLOT_BITS) - 1 };
+    enum { GENERATION_MASK = 0xFFFFFFFFU >> SLOT_BITS };
+    static const size_t NO_INDEX = size_t(-1);
+
+    /*  Handle = (generation << SLOT_BITS) | (slot + 1).
+        A slot is reused after its sprite is removed, with a new
+        generation, so that the old handle becomes invalid.
+        Generations wrap around after GENERATION_MASK.
+    */
+
+    std::vector<Coord> posX, posY, speedX, speedY, accelX, accelY;
+    std::vector<Coord> collBoxX, collBoxY, collBoxW, collBoxH;
+    std::vector<int> sizeX, sizeY;
+    std::vector<unsigned long> timeToLive;
+    std::vector<const PixmapArray *> pixmapArrays;
+    std::vector<size_t> currentPixmapIndices;
+    std::vector<Handle> handles;  // handle of the sprite at each index
+
+    std::vector<size_t> slotIndices;  // index of the sprite of each slot
+    std::vector<Uint32> slotGenerations;  // at most GENERATION_MASK
+    std::vector<size_t> freeSlots;
+
+    /*  Forbidden operations:
+    */
+    BasicSpritePool(const BasicSpritePool &x);
+    BasicSpritePool &operator = (const BasicSpritePool &x);
+};
+
+
+typedef BasicSpritePool<int, Couple> SpritePool;
+typedef BasicSpritePool<double, RCouple> RSpritePool;
+
+
+/*  INLINE METHODS
+*/
+
+template <class Coord, class CoupleType>
+inline size_t
+BasicSpritePool<Coord, CoupleType>::size() const
+{
+    return handles.size();
+}
+
+template <class Coord, class CoupleType>
+inline bool
+BasicSpritePool<Coord, CoupleType>::isValid(Handle h) const
+{
+    size_t slot = size_t(h & SLOT_MASK) - 1;  // wraps if h is zero
+    return slot < slotIndices.size()
+            && slotIndices[slot] != NO_INDEX
+            && slotGenerations[slot] == (h >> SLOT_BITS);
+}
+
+template <class Coord, class CoupleType>
+inline size_t
+BasicSpritePool<Coord, CoupleType>::getIndex(Handle h) const
+{
+    return slotIndices[(h & SLOT_MASK) - 1];
+}
+
+template <class Coord, class CoupleType>
+inline typename BasicSpritePool<Coord, CoupleType>::Handle
+BasicSpritePool<Coord, CoupleType>::getHandle(size_t i) const
+{
+    return handles[i];
+}
+
+template <class Coord, class CoupleType>
+inline CoupleType
+BasicSpritePool<Coord, CoupleType>::getPos(size_t i) const
+{
+    return CoupleType(posX[i], posY[i]);
+}
+
+template <class Coord, class CoupleType>
+inline CoupleType
+BasicSpritePool<Coord, CoupleType>::getSpeed(size_t i) const
+{
+    return CoupleType(speedX[i], speedY[i]);
+}
+
+template <class Coord, class CoupleType>
+inline CoupleType
+BasicSpritePool<Coord, CoupleType>::getAccel(size_t i) const
+{
+    return CoupleType(accelX[i], accelY[i]);
+}
+
+template <class Coord, class CoupleType>
+inline Couple
+BasicSpritePool<Coord, CoupleType>::getSize(size_t i) const
+{
+    return Couple(sizeX[i], sizeY[i]);
+}
+
+template <class Coord, class CoupleType>
+inline CoupleType
+BasicSpritePool<Coord, CoupleType>::getCollBoxPos(size_t i) const
+{
+    return CoupleType(collBoxX[i], collBoxY[i]);
+}
+
+template <class Coord, class CoupleType>
+inline CoupleType
+BasicSpritePool<Coord, CoupleType>::getCollBoxSize(size_t i) const
+{
+    return CoupleType(collBoxW[i], collBoxH[i]);
+}
+
+template <class Coord, class CoupleType>
+inline void
+BasicSpritePool<Coord, CoupleType>::setPos(size_t i, const CoupleType &c)
+{
+    posX[i] = c.x;
+    posY[i] = c.y;
+}
+
+template <class Coord, class CoupleType>
+inline void
+BasicSpritePool<Coord, CoupleType>::setSpeed(size_t i, const CoupleType &c)
+{
+    speedX[i] = c.x;
+    speedY[i] = c.y;
+}
+
+template <class Coord, class CoupleType>
+inline void
+BasicSpritePool<Coord, CoupleType>::setAccel(size_t i, const CoupleType &c)
+{
+    accelX[i] = c.x;
+    accelY[i] = c.y;
+}
+
+template <class Coord, class CoupleType>
+inline void
+BasicSpritePool<Coord, CoupleType>::setCollBoxPos(size_t i, const CoupleType &c)
+{
+    collBoxX[i] = c.x;
+    collBoxY[i] = c.y;
+}
+
+template <class Coord, class CoupleType>
+inline void
+BasicSpritePool<Coord, CoupleType>::setCollBoxSize(size_t i, const CoupleType &c)
+{
+    collBoxW[i] = c.x;
+    collBoxH[i] = c.y;
+}
+
+template <class Coord, class CoupleType>
+inline unsigned long
+BasicSpritePool<Coord, CoupleType>::getTimeToLive(size_t i) const
+{
+    return timeToLive[i];
+}
+
+template <class Coord, class CoupleType>
+inline void
+BasicSpritePool<Coord, CoupleType>::setTimeToLive(size_t i, unsigned long t)
+{
+    timeToLive[i] = t;
+}
+
+template <class Coord, class CoupleType>
+inline const PixmapArray *
+BasicSpritePool<Coord, CoupleType>::getPixmapArray(size_t i) const
+{
+    return pixmapArrays[i];
+}
+
+template <class Coord, class CoupleType>
+inline SDL_Surface *
+BasicSpritePool<Coord, CoupleType>::getPixmap(size_t i, size_t pixmapNo) const
+{
+    return pixmapArrays[i]->getImage(pixmapNo);
+}
+
+template <class Coord, class CoupleType>
+inline size_t
+BasicSpritePool<Coord, CoupleType>::getCurrentPixmapIndex(size_t i) const
+{
+    return currentPixmapIndices[i];
+}
+
+template <class Coord, class CoupleType>
+inline void
+BasicSpritePool<Coord, CoupleType>::setCurrentPixmapIndex(size_t i, size_t pixmapNo)
+{
+    currentPixmapIndices[i] = pixmapNo;
+}
+
+template <class Coord, class CoupleType>
+inline bool
+BasicSpritePool<Coord, CoupleType>::collides(size_t i, size_t j) const
+{
+    Coord x1 = posX[i] + collBoxX[i], y1 = posY[i] + collBoxY[i];
+    Coord x2 = posX[j] + collBoxX[j], y2 = posY[j] + collBoxY[j];
+    return x1 + collBoxW[i] > x2 && y1 + collBoxH[i] > y2
+            && x2 + collBoxW[j] > x1 && y2 + collBoxH[j] > y1;
+}
+
+template <class Coord, class CoupleType>
+inline Coord *
+BasicSpritePool<Coord, CoupleType>::getPosXArray()
+{
+    return posX.empty() ? NULL : &posX[0];
+}
+
+template <class Coord, class CoupleType>
+inline Coord *
+BasicSpritePool<Coord, CoupleType>::getPosYArray()
+{
+    return posY.empty() ? NULL : &posY[0];
+}
+
+template <class Coord, class CoupleType>
+inline Coord *
+BasicSpritePool<Coord, CoupleType>::getSpeedXArray()
+{
+    return speedX.empty() ? NULL : &speedX[0];
+}
+
+template <class Coord, class CoupleType>
+inline Coord *
+BasicSpritePool<Coord, CoupleType>::getSpeedYArray()
+{
+    return speedY.empty() ? NULL : &speedY[0];
+}
+
+template <class Coord, class CoupleType>
+inline Coord *
+BasicSpritePool<Coord, CoupleType>::getAccelXArray()
+{
+    return accelX.empty() ? NULL : &accelX[0];
+}
+
+template <class Coord, class CoupleType>
+inline Coord *
+BasicSpritePool<Coord, CoupleType>::getAccelYArray()
+{
+    return accelY.empty() ? NULL : &accelY[0];
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_SpritePool */
@@ -0,0 +1,221 @@
+/*  $Id$
+    SweepAndPrune.cpp - Sweep and prune collision detection between RSprites.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#include <flatzebra/SweepAndPrune.h>
+
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+bool
+SweepAndPrune::EndPoint::operator < (const EndPoint &e) const
+{
+    if (x != e.x)
+        return x < e.x;
+
+    // Boxes that only touch do not collide (see rectangleCollision()),
+    // so a right end comes before a left end at the same position.
+    return isRight && !e.isRight;
+}
+
+
+SweepAndPrune::SweepAndPrune()
+  : boxes(),
+    freeBoxes(),
+    endPoints(),
+    boxIndices(),
+    active(),
+    activePositions()
+{
+}
+
+
+SweepAndPrune::~SweepAndPrune()
+{
+}
+
+
+void
+SweepAndPrune::addRSprite(RSprite *s)
+{
+    assert(s != NULL);
+    assert(boxIndices.find(s) == boxIndices.end());
+
+    size_t b;
+    if (freeBoxes.empty())
+    {
+        b = boxes.size();
+        boxes.push_back(Box());
+    }
+    else
+    {
+        b = freeBoxes.back();
+        freeBoxes.pop_back();
+    }
+    boxIndices[s] = b;
+
+    // The coordinates are set by the next update(), which also
+    // moves the new ends to their place.
+    Box box = { s, 0, 0, true };
+    boxes[b] = box;
+    EndPoint left = { 0, b, false };
+    EndPoint right = { 0, b, true };
+    endPoints.push_back(left);
+    endPoints.push_back(right);
+}
+
+
+void
+SweepAndPrune::addRSprites(const RSpriteList &sl)
+{
+    for (RSpriteList::const_iterator it = sl.begin(); it != sl.end(); it++)
+        addRSprite(*it);
+}
+
+
+void
+SweepAndPrune::removeRSprite(RSprite *s)
+{
+    map<RSprite *, size_t>::iterator it = boxIndices.find(s);
+    assert(it != boxIndices.end());
+    size_t b = it->second;
+    boxIndices.erase(it);
+
+    // Remove both ends while keeping the others in order.
+    size_t kept = 0;
+    for (size_t i = 0; i < endPoints.size(); i++)
+        if (endPoints[i].box != b)
+            endPoints[kept++] = endPoints[i];
+    endPoints.resize(kept);
+
+    boxes[b].sprite = NULL;
+    freeBoxes.push_back(b);
+}
+
+
+void
+SweepAndPrune::clear()
+{
+    boxes.clear();
+    freeBoxes.clear();
+    endPoints.clear();
+    boxIndices.clear();
+}
+
+
+void
+SweepAndPrune::update()
+{
+    for (vector<Box>::iterator it = boxes.begin(); it != boxes.end(); it++)
+    {
+        if (it->sprite == NULL)
+            continue;
+        it->top = it->sprite->getPos().y + it->sprite->getCollBoxPos().y;
+        it->bottom = it->top + it->sprite->getCollBoxSize().y;
+
+        /*  A box without area collides with nothing. Its right end may
+            also come before its left end in the sort order (see
+            EndPoint::operator <), which the sweep cannot handle.
+        */
+        it->empty = (it->sprite->getCollBoxSize().x <= 0
+                     || it->bottom <= it->top);
+    }
+
+    const size_t n = endPoints.size();
+    for (size_t i = 0; i < n; i++)
+    {
+        EndPoint &e = endPoints[i];
+        const RSprite *s = boxes[e.box].sprite;
+        e.x = s->getPos().x + s->getCollBoxPos().x;
+        if (e.isRight)
+            e.x += s->getCollBoxSize().x;
+    }
+
+    /*  Insertion sort: linear when the order has not changed, and
+        close to linear when the sprites have only moved a little.
+    */
+    for (size_t i = 1; i < n; i++)
+    {
+        if (!(endPoints[i] < endPoints[i - 1]))
+            continue;
+        EndPoint e = endPoints[i];
+        size_t j = i;
+        do
+        {
+            endPoints[j] = endPoints[j - 1];
+            j--;
+        } while (j > 0 && e < endPoints[j - 1]);
+        endPoints[j] = e;
+    }
+}
+
+
+void
+SweepAndPrune::getCollidingPairs(RSpritePairList &pairs) const
+{
+    // 'active' contains the boxes whose left end has been passed
+    // but not their right end.
+    active.clear();
+    activePositions.resize(boxes.size());
+
+    for (vector<EndPoint>::const_iterator it = endPoints.begin();
+                                        it != endPoints.end(); it++)
+    {
+        const size_t b = it->box;
+        if (boxes[b].empty)
+            continue;
+
+        if (it->isRight)
+        {
+            // Remove 'b' from 'active' by moving the last element
+            // into its place.
+            assert(!active.empty() && active[activePositions[b]] == b);
+            size_t pos = activePositions[b];
+            size_t last = active.back();
+            active[pos] = last;
+            activePositions[last] = pos;
+            active.pop_back();
+            continue;
+        }
+
+        const Box &box = boxes[b];
+        for (vector<size_t>::const_iterator jt = active.begin();
+                                            jt != active.end(); jt++)
+        {
+            const Box &other = boxes[*jt];
+            if (box.bottom <= other.top || other.bottom <= box.top)
+                continue;  // the y intervals do not overlap
+
+            const RSprite &s1 = *box.sprite;
+            const RSprite &s2 = *other.sprite;
+            if (RCouple::rectangleCollision(
+                            s1.getPos() + s1.getCollBoxPos(), s1.getCollBoxSize(),
+                            s2.getPos() + s2.getCollBoxPos(), s2.getCollBoxSize()))
+                pairs.push_back(make_pair(other.sprite, box.sprite));
+        }
+
+        activePositions[b] = active.size();
+        active.push_back(b);
+    }
+}
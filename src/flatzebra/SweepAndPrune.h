@@ -0,0 +1,138 @@
+/*  $Id$
+    SweepAndPrune.h - Sweep and prune collision detection between RSprites.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+#ifndef _H_SweepAndPrune
+#define _H_SweepAndPrune
+
+#include <flatzebra/RSprite.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+
+namespace flatzebra {
+
+
+typedef std::vector< std::pair<RSprite *, RSprite *> > RSpritePairList;
+
+
+class SweepAndPrune
+/*  Finds the pairs of RSprites whose collision boxes intersect.
+
+    The left and right ends of the collision boxes are kept sorted along
+    the x axis from one frame to the next. Since sprites usually move by
+    a few pixels per frame, the order changes little and update() re-sorts
+    it by insertion in nearly linear time. getCollidingPairs() then sweeps
+    the ends from left to right and only tests the boxes whose x intervals
+    overlap.
+
+    The object does not watch the sprites: call update() after moving
+    them and before calling getCollidingPairs().
+*/
+{
+public:
+
+    SweepAndPrune();
+    /*  Creates an empty set of sprites.
+    */
+
+    ~SweepAndPrune();
+    /*  Does not destroy the sprites.
+    */
+
+    void addRSprite(RSprite *s);
+    void addRSprites(const RSpriteList &sl);
+    /*  Adds sprites to the set.
+        This object does not become the owner of the sprites.
+        A sprite must not be added twice.
+    */
+
+    void removeRSprite(RSprite *s);
+    /*  Removes a sprite from the set.
+        Must be called before a sprite that is in the set is destroyed.
+    */
+
+    void clear();
+    /*  Removes all the sprites from the set.
+    */
+
+    size_t getNumRSprites() const;
+
+    void update();
+    /*  Reads the current collision boxes of the sprites (getPos()
+        + getCollBoxPos(), of size getCollBoxSize()) and re-sorts the
+        interval ends.
+    */
+
+    void getCollidingPairs(RSpritePairList &pairs) const;
+    /*  Appends to 'pairs' every pair of sprites whose collision boxes,
+        as of the last call to update(), have an intersection of
+        non-zero area. Each pair is reported once.
+        Boxes of zero or negative width or height collide with nothing,
+        even though RCouple::rectangleCollision() reports a collision
+        between such a box and a box that strictly contains it.
+    */
+
+private:
+
+    struct Box
+    {
+        RSprite *sprite;  // NULL if this box is free
+        double top, bottom;
+        bool empty;  // true if the box has no area; left out of the sweep
+    };
+
+    struct EndPoint
+    {
+        double x;
+        size_t box;   // index in 'boxes'
+        bool isRight;
+
+        bool operator < (const EndPoint &e) const;
+    };
+
+    std::vector<Box> boxes;
+    std::vector<size_t> freeBoxes;  // indices of free elements of 'boxes'
+    std::vector<EndPoint> endPoints;  // sorted by update()
+    std::map<RSprite *, size_t> boxIndices;
+    mutable std::vector<size_t> active;  // used by getCollidingPairs()
+    mutable std::vector<size_t> activePositions;  // index of each box in 'active'
+
+    /*  Forbidden operations:
+    */
+    SweepAndPrune(const SweepAndPrune &x);
+    SweepAndPrune &operator = (const SweepAndPrune &x);
+};
+
+
+/*  INLINE METHODS
+*/
+
+inline size_t
+SweepAndPrune::getNumRSprites() const { return boxIndices.size(); }
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_SweepAndPrune */
@@ -0,0 +1,280 @@
+/*  $Id$
+    TelemetryRecorder.cpp - Ring buffer of timed engine events, exported to files.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/TelemetryRecorder.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+TelemetryRecorder::TelemetryRecorder(size_t capacity)
+  : mutex(SDL_CreateMutex()),
+    enabled(false),
+    events(capacity),
+    nextEvent(0),
+    numEvents(0),
+    flushFinished(true),
+    flushThread(NULL),
+    flushEvents(),
+    flushFileName(),
+    flushFormat(CHROME_TRACE_JSON),
+    flushSucceeded(true)
+{
+    assert(capacity > 0);
+    flushEvents.reserve(capacity);
+}
+
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+    (void) waitForFlush();
+    SDL_DestroyMutex(mutex);
+}
+
+
+void
+TelemetryRecorder::setEnabled(bool enable)
+{
+    enabled = enable && mutex != NULL;
+}
+
+
+void
+TelemetryRecorder::record(EventType type, const char *name, Sint64 value)
+{
+    if (!enabled)
+        return;
+
+    Uint64 now = MonotonicClock::getNanoseconds();
+    Uint32 threadID = SDL_ThreadID();
+
+    SDL_LockMutex(mutex);
+    Event &e = events[nextEvent];
+    e.timestamp = now;
+    e.name = name;
+    e.value = value;
+    e.threadID = threadID;
+    e.type = type;
+    nextEvent = (nextEvent + 1) % events.size();
+    if (numEvents < events.size())
+        numEvents++;
+    SDL_UnlockMutex(mutex);
+}
+
+
+size_t
+TelemetryRecorder::getNumEvents() const
+{
+    return numEvents;
+}
+
+
+void
+TelemetryRecorder::clear()
+{
+    SDL_LockMutex(mutex);
+    nextEvent = 0;
+    numEvents = 0;
+    SDL_UnlockMutex(mutex);
+}
+
+
+bool
+TelemetryRecorder::flush(const string &fileName, Format format)
+{
+    if (mutex == NULL)
+        return false;
+
+    if (flushThread != NULL)
+    {
+        SDL_LockMutex(mutex);
+        bool finished = flushFinished;
+        SDL_UnlockMutex(mutex);
+        if (!finished)
+            return false;
+        (void) waitForFlush();  // joins the finished thread
+    }
+
+    // Move the events, oldest first, so that recording can go on.
+    SDL_LockMutex(mutex);
+    flushEvents.clear();
+    size_t first = (nextEvent + events.size() - numEvents) % events.size();
+    for (size_t i = 0; i < numEvents; i++)
+        flushEvents.push_back(events[(first + i) % events.size()]);
+    numEvents = 0;
+    nextEvent = 0;
+    flushFinished = false;
+    SDL_UnlockMutex(mutex);
+
+    flushFileName = fileName;
+    flushFormat = format;
+    flushThread = SDL_CreateThread(flushThreadMain, this);
+    if (flushThread != NULL)
+        return true;
+
+    /*  Put the moved events back in the buffer, before those that have
+        been recorded since, keeping the most recent ones if they
+        do not all fit.
+    */
+    SDL_LockMutex(mutex);
+    first = (nextEvent + events.size() - numEvents) % events.size();
+    for (size_t i = 0; i < numEvents; i++)
+        flushEvents.push_back(events[(first + i) % events.size()]);
+    size_t skipped = flushEvents.size() - min(flushEvents.size(), events.size());
+    numEvents = flushEvents.size() - skipped;
+    for (size_t i = 0; i < numEvents; i++)
+        events[i] = flushEvents[skipped + i];
+    nextEvent = numEvents % events.size();
+    flushFinished = true;
+    SDL_UnlockMutex(mutex);
+    flushEvents.clear();
+    return false;
+}
+
+
+bool
+TelemetryRecorder::waitForFlush()
+{
+    if (flushThread != NULL)
+    {
+        SDL_WaitThread(flushThread, NULL);
+        flushThread = NULL;
+    }
+    return flushSucceeded;
+}
+
+
+/*static*/
+int
+TelemetryRecorder::flushThreadMain(void *recorder)
+{
+    TelemetryRecorder *r = static_cast<TelemetryRecorder *>(recorder);
+    r->flushSucceeded = writeEvents(r->flushFileName, r->flushFormat, r->flushEvents);
+    SDL_LockMutex(r->mutex);
+    r->flushFinished = true;
+    SDL_UnlockMutex(r->mutex);
+    return 0;
+}
+
+
+static void
+writeJSONString(FILE *file, const char *s)
+{
+    putc('"', file);
+    for ( ; s != NULL && *s != '\0'; s++)
+    {
+        unsigned char c = (unsigned char) *s;
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (c < 32)
+            fprintf(file, "\\u%04x", c);
+        else
+            putc(c, file);
+    }
+    putc('"', file);
+}
+
+
+static void
+writeCSVString(FILE *file, const char *s)
+{
+    if (s == NULL || strpbrk(s, ",\"\n") == NULL)
+    {
+        fputs(s != NULL ? s : "", file);
+        return;
+    }
+    putc('"', file);
+    for ( ; *s != '\0'; s++)
+    {
+        if (*s == '"')
+            putc('"', file);  // doubled
+        putc(*s, file);
+    }
+    putc('"', file);
+}
+
+
+/*static*/
+bool
+TelemetryRecorder::writeEvents(const string &fileName, Format format,
+                               const vector<Event> &events)
+{
+    FILE *file = fopen(fileName.c_str(), "w");
+    if (file == NULL)
+        return false;
+
+    // Times are written relative to the first event.
+    Uint64 origin = (events.empty() ? 0 : events.front().timestamp);
+
+    if (format == CSV)
+    {
+        static const char *typeNames[] = { "begin", "end", "instant", "counter" };
+        fprintf(file, "timestamp_ns,thread,type,name,value\n");
+        for (vector<Event>::const_iterator it = events.begin(); it != events.end(); ++it)
+        {
+            fprintf(file, "%llu,%lu,%s,",
+                    (unsigned long long) (it->timestamp - origin),
+                    (unsigned long) it->threadID,
+                    typeNames[it->type]);
+            writeCSVString(file, it->name);
+            fprintf(file, ",%lld\n", (long long) it->value);
+        }
+    }
+    else
+    {
+        static const char *phases[] = { "B", "E", "i", "C" };
+        fprintf(file, "{\"traceEvents\":[\n");
+        for (vector<Event>::const_iterator it = events.begin(); it != events.end(); ++it)
+        {
+            if (it != events.begin())
+                fprintf(file, ",\n");
+            fprintf(file, "{\"name\":");
+            writeJSONString(file, it->name);
+            fprintf(file, ",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%lu",
+                    phases[it->type],
+                    (it->timestamp - origin) / 1000.0,  // microseconds
+                    (unsigned long) it->threadID);
+            if (it->type == INSTANT)
+                fprintf(file, ",\"s\":\"t\",\"args\":{\"value\":%lld}",
+                        (long long) it->value);
+            else if (it->type == COUNTER)
+            {
+                fprintf(file, ",\"args\":{");
+                writeJSONString(file, it->name);
+                fprintf(file, ":%lld}", (long long) it->value);
+            }
+            putc('}', file);
+        }
+        fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    }
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0)
+        ok = false;
+    return ok;
+}
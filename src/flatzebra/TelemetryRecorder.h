@@ -0,0 +1,240 @@
+/*  $Id$
+    TelemetryRecorder.h - Ring buffer of timed engine events, exported to files.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_TelemetryRecorder
+#define _H_TelemetryRecorder
+
+#include <flatzebra/MonotonicClock.h>
+
+#include <SDL.h>
+
+#include <string>
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class TelemetryRecorder
+/*  Records timestamped events in a fixed-size ring buffer, and writes
+    them to a file in the Chrome trace event format (viewable with
+    chrome://tracing or Perfetto) or in CSV.
+
+    The buffer is allocated by the constructor: recording an event
+    does not allocate memory. When the buffer is full, the oldest
+    events are overwritten, so the buffer always holds the most recent
+    history, e.g., the frames that preceded a hitch.
+
+    Events can be recorded from any thread.
+    Writing the file is done on a separate thread.
+*/
+{
+public:
+
+    enum EventType
+    {
+        BEGIN,    // start of a duration named 'name'
+        END,      // end of the most recent BEGIN with the same thread
+        INSTANT,  // something happened, with an optional value
+        COUNTER   // 'name' now has the value 'value'
+    };
+
+    enum Format
+    {
+        CHROME_TRACE_JSON,
+        CSV
+    };
+
+    struct Event
+    {
+        Uint64 timestamp;  // MonotonicClock nanoseconds
+        const char *name;  // must be a string that is never freed
+        Sint64 value;
+        Uint32 threadID;
+        EventType type;
+    };
+
+    TelemetryRecorder(size_t capacity = 65536);
+    /*  Allocates a buffer of 'capacity' events (which must be positive).
+        The recorder is disabled.
+    */
+
+    ~TelemetryRecorder();
+    /*  Waits for the end of the file writing in progress, if any.
+    */
+
+    void setEnabled(bool enable);
+    bool isEnabled() const;
+    /*  When disabled, the record*() methods do nothing.
+    */
+
+    void record(EventType type, const char *name, Sint64 value = 0);
+    void recordBegin(const char *name);
+    void recordEnd(const char *name);
+    void recordInstant(const char *name, Sint64 value = 0);
+    void recordCounter(const char *name, Sint64 value);
+    /*  Record an event now, if enabled.
+        'name' must be a string literal or a string that is never freed,
+        since only its address is stored.
+    */
+
+    size_t getNumEvents() const;
+    /*  Number of events currently in the buffer.
+    */
+
+    void clear();
+    /*  Removes all the events from the buffer.
+    */
+
+    bool flush(const std::string &fileName, Format format);
+    /*  Starts writing the events of the buffer to the named file, on
+        another thread, and empties the buffer. Returns immediately.
+        Returns false if a previous flush is still in progress, or if
+        the thread cannot be started, in which case the buffer
+        is not emptied. A previous flush that has finished does not
+        need to be waited for.
+    */
+
+    bool waitForFlush();
+    /*  Waits for the end of the flush in progress, if any.
+        Returns true if the last flush succeeded, or false if
+        the file could not be written.
+    */
+
+    static bool writeEvents(const std::string &fileName, Format format,
+                            const std::vector<Event> &events);
+    /*  Writes 'events' to a file synchronously.
+        Returns false if the file could not be written.
+    */
+
+private:
+
+    static int flushThreadMain(void *recorder);
+
+    SDL_mutex *mutex;  // protects the members below
+    bool enabled;
+    std::vector<Event> events;  // ring buffer
+    size_t nextEvent;  // index in 'events' of the next event to record
+    size_t numEvents;
+    bool flushFinished;  // set by the flush thread when it is done
+
+    // Flush in progress (only used by the thread that calls flush()):
+    SDL_Thread *flushThread;  // NULL once joined
+    std::vector<Event> flushEvents;  // oldest first
+    std::string flushFileName;
+    Format flushFormat;
+    bool flushSucceeded;
+
+    /*  Forbidden operations:
+    */
+    TelemetryRecorder(const TelemetryRecorder &);
+    TelemetryRecorder &operator = (const TelemetryRecorder &);
+};
+
+
+class TelemetryScope
+/*  Records a BEGIN event at construction and the matching END event
+    at destruction.
+*/
+{
+public:
+
+    TelemetryScope(TelemetryRecorder &recorder, const char *name);
+    ~TelemetryScope();
+
+private:
+
+    TelemetryRecorder &recorder;
+    const char *name;
+
+    /*  Forbidden operations:
+    */
+    TelemetryScope(const TelemetryScope &);
+    TelemetryScope &operator = (const TelemetryScope &);
+};
+
+
+inline
+bool
+TelemetryRecorder::isEnabled() const
+{
+    return enabled;
+}
+
+
+inline
+void
+TelemetryRecorder::recordBegin(const char *name)
+{
+    if (enabled)
+        record(BEGIN, name);
+}
+
+
+inline
+void
+TelemetryRecorder::recordEnd(const char *name)
+{
+    if (enabled)
+        record(END, name);
+}
+
+
+inline
+void
+TelemetryRecorder::recordInstant(const char *name, Sint64 value)
+{
+    if (enabled)
+        record(INSTANT, name, value);
+}
+
+
+inline
+void
+TelemetryRecorder::recordCounter(const char *name, Sint64 value)
+{
+    if (enabled)
+        record(COUNTER, name, value);
+}
+
+
+inline
+TelemetryScope::TelemetryScope(TelemetryRecorder &r, const char *n)
+  : recorder(r),
+    name(n)
+{
+    recorder.recordBegin(name);
+}
+
+
+inline
+TelemetryScope::~TelemetryScope()
+{
+    recorder.recordEnd(name);
+}
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_TelemetryRecorder */
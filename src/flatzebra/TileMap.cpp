@@ -0,0 +1,177 @@
+/*  $Id$
+    TileMap.cpp - Layer of tiles drawn from pre-rendered chunks.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/TileMap.h>
+
+#include <flatzebra/PixmapArray.h>
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+static const Uint16 EMPTY = 0xFFFF;  // stored value of TileMap::NO_TILE
+
+const size_t TileMap::NO_TILE = size_t(-1);
+
+
+TileMap::TileMap(const PixmapArray &_tiles, Couple _tileSize,
+                 Couple _sizeInTiles, Couple chunkSizeInTiles,
+                 bool _transparent)
+  : tiles(_tiles),
+    tileSize(_tileSize),
+    sizeInTiles(_sizeInTiles),
+    chunkSize(chunkSizeInTiles),
+    numChunks((_sizeInTiles.x + chunkSizeInTiles.x - 1) / chunkSizeInTiles.x,
+              (_sizeInTiles.y + chunkSizeInTiles.y - 1) / chunkSizeInTiles.y),
+    transparent(_transparent),
+    tileIndices(size_t(_sizeInTiles.x) * _sizeInTiles.y, EMPTY),
+    chunks(),
+    numChunksRendered(0)
+{
+    assert(tileSize.x > 0 && tileSize.y > 0);
+    assert(sizeInTiles.x > 0 && sizeInTiles.y > 0);
+    assert(chunkSize.x > 0 && chunkSize.y > 0);
+
+    Chunk empty = { NULL, true };
+    chunks.resize(size_t(numChunks.x) * numChunks.y, empty);
+}
+
+
+TileMap::~TileMap()
+{
+    for (vector<Chunk>::iterator it = chunks.begin(); it != chunks.end(); it++)
+        SDL_FreeSurface(it->surface);
+}
+
+
+void
+TileMap::setTile(int col, int row, size_t tile)
+{
+    assert(col >= 0 && col < sizeInTiles.x);
+    assert(row >= 0 && row < sizeInTiles.y);
+    assert(tile == NO_TILE || tile < EMPTY);
+
+    Uint16 &t = tileIndices[size_t(row) * sizeInTiles.x + col];
+    Uint16 value = (tile == NO_TILE ? EMPTY : Uint16(tile));
+    if (t == value)
+        return;
+    t = value;
+    getChunk(col / chunkSize.x, row / chunkSize.y).dirty = true;
+}
+
+
+size_t
+TileMap::getTile(int col, int row) const
+{
+    assert(col >= 0 && col < sizeInTiles.x);
+    assert(row >= 0 && row < sizeInTiles.y);
+
+    Uint16 t = tileIndices[size_t(row) * sizeInTiles.x + col];
+    return t == EMPTY ? NO_TILE : t;
+}
+
+
+void
+TileMap::invalidate()
+{
+    for (vector<Chunk>::iterator it = chunks.begin(); it != chunks.end(); it++)
+        it->dirty = true;
+}
+
+
+TileMap::Chunk &
+TileMap::getChunk(int chunkCol, int chunkRow)
+{
+    assert(chunkCol >= 0 && chunkCol < numChunks.x);
+    assert(chunkRow >= 0 && chunkRow < numChunks.y);
+    return chunks[size_t(chunkRow) * numChunks.x + chunkCol];
+}
+
+
+SDL_Surface *
+TileMap::getChunkSurface(int chunkCol, int chunkRow)
+{
+    Chunk &chunk = getChunk(chunkCol, chunkRow);
+    if (chunk.dirty || chunk.surface == NULL
+            || !PixmapArray::hasDisplayFormat(chunk.surface))
+        if (!render(chunkCol, chunkRow))
+            return NULL;
+    return chunk.surface;
+}
+
+
+bool
+TileMap::render(int chunkCol, int chunkRow)
+{
+    Chunk &chunk = getChunk(chunkCol, chunkRow);
+    Couple first(chunkCol * chunkSize.x, chunkRow * chunkSize.y);
+    Couple count(min(chunkSize.x, sizeInTiles.x - first.x),
+                 min(chunkSize.y, sizeInTiles.y - first.y));
+
+    if (chunk.surface != NULL && !PixmapArray::hasDisplayFormat(chunk.surface))
+    {
+        SDL_FreeSurface(chunk.surface);
+        chunk.surface = NULL;
+    }
+    if (chunk.surface == NULL)
+    {
+        chunk.surface = PixmapArray::createDisplaySurface(
+                    Couple(count.x * tileSize.x, count.y * tileSize.y));
+        if (chunk.surface == NULL)
+            return false;
+    }
+
+    SDL_Surface *surface = chunk.surface;
+    Uint32 background = (transparent
+                            ? SDL_MapRGB(surface->format, 255, 0, 255)
+                            : SDL_MapRGB(surface->format, 0, 0, 0));
+    SDL_SetColorKey(surface, 0, 0);  // no RLE encoding while rendering
+    SDL_FillRect(surface, NULL, background);
+
+    for (int row = 0; row < count.y; row++)
+    {
+        const Uint16 *t = &tileIndices[size_t(first.y + row) * sizeInTiles.x
+                                       + first.x];
+        for (int col = 0; col < count.x; col++)
+        {
+            if (t[col] == EMPTY)
+                continue;
+            assert(t[col] < tiles.getNumImages());
+            SDL_Rect srcrect = tiles.getImageRect(t[col]);
+            srcrect.w = Uint16(tileSize.x);
+            srcrect.h = Uint16(tileSize.y);
+            SDL_Rect dstrect = { Sint16(col * tileSize.x),
+                                 Sint16(row * tileSize.y), 0, 0 };
+            SDL_BlitSurface(tiles.getImage(t[col]), &srcrect, surface, &dstrect);
+        }
+    }
+
+    if (transparent)
+        SDL_SetColorKey(surface, SDL_SRCCOLORKEY | SDL_RLEACCEL, background);
+    chunk.dirty = false;
+    numChunksRendered++;
+    return true;
+}
@@ -0,0 +1,172 @@
+/*  $Id$
+    TileMap.h - Layer of tiles drawn from pre-rendered chunks.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_TileMap
+#define _H_TileMap
+
+#include <flatzebra/Couple.h>
+
+#include <SDL.h>
+
+#include <vector>
+
+
+namespace flatzebra {
+
+
+class PixmapArray;
+
+
+class TileMap
+/*  Layer of tiles, e.g., the terrain of a level, where each tile is
+    an image of a PixmapArray.
+
+    The map is split into chunks of a fixed number of tiles. Each chunk
+    is pre-rendered into a surface in the display format (see
+    PixmapArray::getDisplaySurface()) the first time that it is needed,
+    and it is only rendered again when one of its tiles has changed.
+    Drawing the visible part of the map thus takes a few large blits
+    instead of one blit per tile. See GameEngine::copyTileMap().
+
+    Tile indices are stored in 16 bits, which is enough for the
+    images that a PixmapArray accepts.
+*/
+{
+public:
+
+    enum { DEFAULT_CHUNK_SIZE = 8 };
+
+    static const size_t NO_TILE;
+    /*  Index of the empty tiles.
+    */
+
+    TileMap(const PixmapArray &tiles, Couple tileSize, Couple sizeInTiles,
+            Couple chunkSizeInTiles = Couple(DEFAULT_CHUNK_SIZE,
+                                             DEFAULT_CHUNK_SIZE),
+            bool transparent = false);
+    /*  Creates a map of sizeInTiles.x columns and sizeInTiles.y rows
+        of empty tiles, each tileSize.x by tileSize.y pixels.
+        The images of 'tiles' must be at least that large, and 'tiles'
+        must remain valid as long as this map exists.
+        All the components of the Couple arguments must be positive.
+        If 'transparent' is false, the empty tiles and the transparent
+        pixels of the tiles are black, and the chunks are opaque.
+        Otherwise, they show what is drawn under the map; the chunks
+        then use magenta (255, 0, 255) as their color key, so the tiles
+        must not contain that color.
+    */
+
+    ~TileMap();
+
+    void setTile(int col, int row, size_t tile);
+    size_t getTile(int col, int row) const;
+    /*  Image of 'tiles' at the given column and row, or NO_TILE.
+        Setting a different value marks the chunk that contains the
+        tile for rendering.
+    */
+
+    void invalidate();
+    /*  Marks all the chunks for rendering, e.g., after the images of
+        'tiles' have changed.
+    */
+
+    Couple getTileSize() const;
+    Couple getSizeInTiles() const;
+    Couple getSizeInPixels() const;
+    Couple getChunkSizeInTiles() const;
+    Couple getChunkSizeInPixels() const;
+    Couple getNumChunks() const;
+    /*  Dimensions of the tiles, of the map and of its chunks.
+        The chunks of the last column and of the last row may be
+        smaller if the map is not a multiple of the chunk size.
+    */
+
+    SDL_Surface *getChunkSurface(int chunkCol, int chunkRow);
+    /*  Returns the surface of the given chunk, after rendering it if
+        it has never been rendered, if one of its tiles has changed or
+        if the display format has changed.
+        Returns NULL if the surface cannot be created, e.g., because
+        no video mode has been set.
+        The surface belongs to this map.
+    */
+
+    unsigned long getNumChunksRendered() const;
+    /*  Returns the number of chunk renderings since this map was
+        created.
+    */
+
+private:
+
+    struct Chunk
+    {
+        SDL_Surface *surface;  // owned; NULL if never rendered
+        bool dirty;  // true if 'surface' must be rendered
+    };
+
+    Chunk &getChunk(int chunkCol, int chunkRow);
+    bool render(int chunkCol, int chunkRow);
+
+    const PixmapArray &tiles;
+    Couple tileSize;
+    Couple sizeInTiles;
+    Couple chunkSize;  // in tiles
+    Couple numChunks;
+    bool transparent;
+    std::vector<Uint16> tileIndices;  // row by row; 0xFFFF is NO_TILE
+    std::vector<Chunk> chunks;  // row by row
+    unsigned long numChunksRendered;
+
+
+    /*  Forbidden operations:
+    */
+    TileMap(const TileMap &);
+    TileMap &operator = (const TileMap &);
+
+};
+
+
+/*  INLINE METHODS
+*/
+
+inline Couple
+TileMap::getTileSize() const { return tileSize; }
+inline Couple
+TileMap::getSizeInTiles() const { return sizeInTiles; }
+inline Couple
+TileMap::getSizeInPixels() const
+{ return Couple(sizeInTiles.x * tileSize.x, sizeInTiles.y * tileSize.y); }
+inline Couple
+TileMap::getChunkSizeInTiles() const { return chunkSize; }
+inline Couple
+TileMap::getChunkSizeInPixels() const
+{ return Couple(chunkSize.x * tileSize.x, chunkSize.y * tileSize.y); }
+inline Couple
+TileMap::getNumChunks() const { return numChunks; }
+inline unsigned long
+TileMap::getNumChunksRendered() const { return numChunksRendered; }
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_TileMap */
@@ -0,0 +1,76 @@
+/*  $Id$
+    Viewport.cpp - Part of a large world seen through a rectangle of the screen.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#include <flatzebra/Viewport.h>
+
+#include <algorithm>
+#include <assert.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+Viewport::Viewport(Couple _screenPos, Couple _size)
+  : screenPos(_screenPos),
+    size(_size),
+    worldSize(0, 0),
+    origin(0, 0)
+{
+    assert(size.x > 0 && size.y > 0);
+}
+
+
+SDL_Rect
+Viewport::getScreenRect() const
+{
+    SDL_Rect r = { Sint16(screenPos.x), Sint16(screenPos.y),
+                   Uint16(size.x), Uint16(size.y) };
+    return r;
+}
+
+
+void
+Viewport::setWorldSize(Couple _worldSize)
+{
+    worldSize = _worldSize;
+    setOrigin(origin);
+}
+
+
+void
+Viewport::setOrigin(Couple worldPos)
+{
+    origin = worldPos;
+    if (worldSize.x == 0 && worldSize.y == 0)
+        return;
+    origin.x = max(0, min(origin.x, worldSize.x - size.x));
+    origin.y = max(0, min(origin.y, worldSize.y - size.y));
+}
+
+
+bool
+Viewport::isVisible(Couple worldPos, Couple rectSize) const
+{
+    return worldPos.x < origin.x + size.x && worldPos.x + rectSize.x > origin.x
+        && worldPos.y < origin.y + size.y && worldPos.y + rectSize.y > origin.y;
+}
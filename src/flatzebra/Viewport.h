@@ -0,0 +1,137 @@
+/*  $Id$
+    Viewport.h - Part of a large world seen through a rectangle of the screen.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+#ifndef _H_Viewport
+#define _H_Viewport
+
+#include <flatzebra/Couple.h>
+
+#include <SDL.h>
+
+
+namespace flatzebra {
+
+
+class Viewport
+/*  Rectangle of the screen through which a part of a larger world
+    is seen, like a camera.
+
+    World coordinates are ints, so a world can be much larger than the
+    Sint16 range of SDL_Rect. The upper-left corner of the rectangle
+    shows the world position given by getOrigin(); scrolling consists
+    in changing that origin.
+
+    See GameEngine::setViewport().
+*/
+{
+public:
+
+    Viewport(Couple screenPos, Couple size);
+    /*  Creates a viewport that occupies the screen rectangle whose
+        upper-left corner is at 'screenPos' and whose dimensions are
+        'size'. Both components of 'size' must be positive.
+        The origin is at (0, 0) and the world is unbounded.
+    */
+
+    Couple getScreenPos() const;
+    Couple getSize() const;
+    SDL_Rect getScreenRect() const;
+    /*  Position, dimensions and rectangle of this viewport on the screen.
+    */
+
+    void setWorldSize(Couple worldSize);
+    Couple getWorldSize() const;
+    /*  Dimensions of the world, whose upper-left corner is at (0, 0).
+        When set, setOrigin(), scrollBy() and centerOn() keep the viewport
+        inside the world, or at (0, 0) on an axis along which the world
+        is smaller than the viewport.
+        A size of (0, 0), the default, means that the world is unbounded.
+    */
+
+    void setOrigin(Couple worldPos);
+    Couple getOrigin() const;
+    /*  World position shown at the upper-left corner of the viewport.
+    */
+
+    void scrollBy(Couple delta);
+    /*  Moves the origin by 'delta'.
+    */
+
+    void centerOn(Couple worldPos);
+    /*  Moves the origin so that 'worldPos' is shown at the center
+        of the viewport.
+    */
+
+    Couple getOffset() const;
+    /*  Returns what must be added to a world position to obtain
+        the corresponding screen position.
+    */
+
+    Couple worldToScreen(Couple worldPos) const;
+    Couple screenToWorld(Couple screenPos) const;
+    /*  Converts a position between the world and the screen.
+    */
+
+    bool isVisible(Couple worldPos, Couple size) const;
+    /*  Returns true if the world rectangle whose upper-left corner is
+        at 'worldPos' and whose dimensions are 'size' overlaps this
+        viewport.
+    */
+
+private:
+
+    Couple screenPos;
+    Couple size;
+    Couple worldSize;  // (0, 0) if unbounded
+    Couple origin;
+
+};
+
+
+/*  INLINE METHODS
+*/
+
+inline Couple
+Viewport::getScreenPos() const { return screenPos; }
+inline Couple
+Viewport::getSize() const { return size; }
+inline Couple
+Viewport::getWorldSize() const { return worldSize; }
+inline Couple
+Viewport::getOrigin() const { return origin; }
+inline Couple
+Viewport::getOffset() const { return screenPos - origin; }
+inline Couple
+Viewport::worldToScreen(Couple p) const { return p + getOffset(); }
+inline Couple
+Viewport::screenToWorld(Couple p) const { return p - getOffset(); }
+inline void
+Viewport::scrollBy(Couple delta) { setOrigin(origin + delta); }
+inline void
+Viewport::centerOn(Couple worldPos) { setOrigin(worldPos - size / 2); }
+
+
+}  // namespace flatzebra
+
+
+#endif  /* _H_Viewport */
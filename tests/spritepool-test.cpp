@@ -0,0 +1,95 @@
+/*  $Id$
+    spritepool-test.cpp - Tests of the handles of the sprite pools.
+
+    flatzebra - Generic 2D Game Engine library
+    Copyright (C) 1999-2012 Pierre Sarrazin <http://sarrazip.com/>
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; either version 2
+    of the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+    02110-1301, USA.
+*/
+
+
+
+#include <flatzebra/SpritePool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+using namespace flatzebra;
+
+
+static int numFailures = 0;
+
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void
+check(bool cond, const char *expr, int line)
+{
+    if (cond)
+        return;
+    fprintf(stderr, "spritepool-test.cpp:%d: check failed: %s\n", line, expr);
+    numFailures++;
+}
+
+
+// Reuses the same slot many more times than there are values in
+// the generation bits of a handle, which wrap around.
+//
+template <class Pool, class CoupleType>
+static void
+testSlotReuse(const PixmapArray &pa, size_t numReuses)
+{
+    Pool pool;
+    typename Pool::Handle kept = pool.add(pa, CoupleType(1, 2));
+    typename Pool::Handle previous = 0;
+
+    for (size_t i = 0; i < numReuses; i++)
+    {
+        typename Pool::Handle h = pool.add(pa, CoupleType(3, 4));
+        CHECK(pool.isValid(h));
+        CHECK(h != previous);
+        CHECK(!pool.isValid(previous));
+        CHECK(pool.size() == 2);
+        CHECK(pool.getHandle(pool.getIndex(h)) == h);
+        CHECK(pool.getPos(pool.getIndex(h)) == CoupleType(3, 4));
+
+        pool.remove(h);
+        CHECK(!pool.isValid(h));
+        CHECK(pool.size() == 1);
+        previous = h;
+    }
+
+    CHECK(pool.isValid(kept));
+    CHECK(pool.getPos(pool.getIndex(kept)) == CoupleType(1, 2));
+}
+
+
+int
+main()
+{
+    PixmapArray pa(1);
+
+    testSlotReuse<SpritePool, Couple>(pa, 1000);
+    testSlotReuse<RSpritePool, RCouple>(pa, 1000);
+
+    if (numFailures != 0)
+    {
+        fprintf(stderr, "spritepool-test: %d failure(s)\n", numFailures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}